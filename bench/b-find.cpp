@@ -0,0 +1,106 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "bu-init.hpp"
+#include <par/pfind.hpp>
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// search for the first element which matches a predicate
+// the iterations are the size of the data, the first match is at a quarter of it
+
+static constexpr uint32_t NUM_THREADS = 8;
+
+std::vector<uint32_t> make_data(int size) {
+    std::vector<uint32_t> data(size);
+    uint32_t x = 12345;
+    for (auto& d : data) {
+        // xorshift, never zero
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        d = x;
+    }
+    data[size / 4] = 0;
+    data[size / 2] = 0;
+    return data;
+}
+
+// not too cheap, so that the search is not entirely memory bound
+// a bijection, so only zeroes match
+constexpr uint32_t hash(uint32_t v) {
+    for (int i = 0; i < 8; ++i) {
+        v = v * 2654435761u + 1;
+    }
+    return v;
+}
+
+inline bool pred(uint32_t v) {
+    return hash(v) == hash(0);
+}
+
+void par_pfind_if(picobench::state& s) {
+    const auto data = make_data(s.iterations());
+    picobench::scope scope(s);
+    auto f = par::pfind_if({.max_par = NUM_THREADS}, 0, s.iterations(), [&](int i) {
+        return pred(data[i]);
+    });
+    s.set_result(f);
+}
+PICOBENCH(par_pfind_if);
+
+// no early exit, all elements are checked
+void par_full_scan(picobench::state& s) {
+    const auto data = make_data(s.iterations());
+    picobench::scope scope(s);
+    std::atomic_int found = INT_MAX;
+    par::pfor({.max_par = NUM_THREADS}, par::range(0, s.iterations()).job_chunk(1024), [&](int i) {
+        if (pred(data[i])) {
+            int cur = found.load(std::memory_order_relaxed);
+            while (i < cur && !found.compare_exchange_weak(cur, i, std::memory_order_relaxed));
+        }
+    });
+    s.set_result(std::min(found.load(), s.iterations()));
+}
+PICOBENCH(par_full_scan);
+
+void openmp_full_scan(picobench::state& s) {
+    const auto data = make_data(s.iterations());
+    picobench::scope scope(s);
+    int found = s.iterations();
+    #pragma omp parallel for num_threads(NUM_THREADS) reduction(min:found)
+    for (int i = 0; i < s.iterations(); ++i) {
+        if (pred(data[i])) {
+            found = std::min(found, i);
+        }
+    }
+    s.set_result(found);
+}
+PICOBENCH(openmp_full_scan);
+
+void linear(picobench::state& s) {
+    const auto data = make_data(s.iterations());
+    picobench::scope scope(s);
+    auto f = std::find_if(data.begin(), data.end(), pred);
+    s.set_result(f - data.begin());
+}
+PICOBENCH(linear);
+
+int main(int argc, char* argv[]) {
+    init_benchmark(NUM_THREADS);
+
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({100'000, 1'000'000, 10'000'000});
+    r.parse_cmd_line(argc, argv);
+
+    return r.run();
+}
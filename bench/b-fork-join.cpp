@@ -0,0 +1,160 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "bu-init.hpp"
+#include <par/task_group.hpp>
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// recursive fork-join with task_group and OpenMP tasks
+// fib: the iterations are n, below the cutoff the recursion is serial
+// quicksort: the iterations are the size of the data, below the cutoff a range is sorted serially
+
+static constexpr uint32_t NUM_THREADS = 8;
+
+constexpr int fib_cutoff = 20;
+constexpr int sort_cutoff = 4096;
+
+uint64_t fib(int n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+uint64_t fib_tg(int n) {
+    if (n < fib_cutoff) return fib(n);
+    uint64_t a, b;
+    par::task_group g;
+    g.spawn([&]() { a = fib_tg(n - 1); });
+    b = fib_tg(n - 2);
+    g.wait();
+    return a + b;
+}
+
+uint64_t fib_omp(int n) {
+    if (n < fib_cutoff) return fib(n);
+    uint64_t a, b;
+    #pragma omp task shared(a)
+    a = fib_omp(n - 1);
+    b = fib_omp(n - 2);
+    #pragma omp taskwait
+    return a + b;
+}
+
+void fib_serial(picobench::state& s) {
+    picobench::scope scope(s);
+    s.set_result(fib(s.iterations()));
+}
+
+void fib_par(picobench::state& s) {
+    picobench::scope scope(s);
+    s.set_result(fib_tg(s.iterations()));
+}
+
+void fib_openmp(picobench::state& s) {
+    uint64_t r;
+    picobench::scope scope(s);
+    #pragma omp parallel num_threads(NUM_THREADS)
+    #pragma omp single
+    r = fib_omp(s.iterations());
+    s.set_result(r);
+}
+
+std::vector<uint32_t> make_data(int size) {
+    std::vector<uint32_t> data(size);
+    uint32_t x = 12345;
+    for (auto& d : data) {
+        // xorshift
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        d = x;
+    }
+    return data;
+}
+
+uint32_t* partition(uint32_t* begin, uint32_t* end) {
+    const auto pivot = begin[(end - begin) / 2];
+    return std::partition(begin, end, [&](uint32_t v) { return v < pivot; });
+}
+
+void sort_par(uint32_t* begin, uint32_t* end) {
+    if (end - begin < sort_cutoff) {
+        std::sort(begin, end);
+        return;
+    }
+    auto mid = partition(begin, end);
+    if (mid == begin) {
+        // the pivot is the smallest element
+        std::sort(begin, end);
+        return;
+    }
+    par::task_group g;
+    g.spawn([=]() { sort_par(begin, mid); });
+    sort_par(mid, end);
+    g.wait();
+}
+
+void sort_omp(uint32_t* begin, uint32_t* end) {
+    if (end - begin < sort_cutoff) {
+        std::sort(begin, end);
+        return;
+    }
+    auto mid = partition(begin, end);
+    if (mid == begin) {
+        std::sort(begin, end);
+        return;
+    }
+    #pragma omp task
+    sort_omp(begin, mid);
+    sort_omp(mid, end);
+    #pragma omp taskwait
+}
+
+void quicksort_serial(picobench::state& s) {
+    auto data = make_data(s.iterations());
+    picobench::scope scope(s);
+    std::sort(data.begin(), data.end());
+    s.set_result(data[data.size() / 2]);
+}
+
+void quicksort_par(picobench::state& s) {
+    auto data = make_data(s.iterations());
+    picobench::scope scope(s);
+    sort_par(data.data(), data.data() + data.size());
+    s.set_result(data[data.size() / 2]);
+}
+
+void quicksort_openmp(picobench::state& s) {
+    auto data = make_data(s.iterations());
+    picobench::scope scope(s);
+    #pragma omp parallel num_threads(NUM_THREADS)
+    #pragma omp single
+    sort_omp(data.data(), data.data() + data.size());
+    s.set_result(data[data.size() / 2]);
+}
+
+PICOBENCH_SUITE("fib");
+PICOBENCH(fib_serial).label("serial").iterations({25, 30, 35});
+PICOBENCH(fib_par).label("par").iterations({25, 30, 35});
+PICOBENCH(fib_openmp).label("openmp").iterations({25, 30, 35});
+
+PICOBENCH_SUITE("quicksort");
+PICOBENCH(quicksort_serial).label("serial");
+PICOBENCH(quicksort_par).label("par");
+PICOBENCH(quicksort_openmp).label("openmp");
+
+int main(int argc, char* argv[]) {
+    init_benchmark(NUM_THREADS);
+
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({100'000, 1'000'000, 10'000'000});
+    r.parse_cmd_line(argc, argv);
+
+    return r.run();
+}
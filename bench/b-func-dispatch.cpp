@@ -0,0 +1,134 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/bits/te_func_ptr.hpp>
+#include <par/bits/inplace_task.hpp>
+#include <functional>
+#include <vector>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// cost of type-erased callables
+// call: invoke already constructed callables, the iterations are the number of calls
+// create: construct, move into a queue, and invoke, the iterations are the number of callables
+
+// bigger than the small buffer of std::function in all major implementations
+struct payload {
+    uintptr_t* sum;
+    uintptr_t a, b, c;
+};
+
+inline auto make_lambda(const payload& p) {
+    return [p](uintptr_t i) {
+        *p.sum += p.a + p.b * i + p.c;
+    };
+}
+
+using lambda_t = decltype(make_lambda(payload{}));
+
+PICOBENCH_SUITE("call");
+
+void te_func_ptr_call(picobench::state& s) {
+    uintptr_t sum = 0;
+    auto lambda = make_lambda({&sum, 1, 2, 3});
+    std::vector<par::te_func_ptr<void(uintptr_t)>> funcs(16, par::te_func_ptr<void(uintptr_t)>(lambda));
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        funcs[i % 16](uintptr_t(i));
+    }
+    s.set_result(sum);
+}
+PICOBENCH(te_func_ptr_call);
+
+void inplace_task_call(picobench::state& s) {
+    uintptr_t sum = 0;
+    std::vector<par::inplace_task<void(uintptr_t)>> funcs;
+    for (int i = 0; i < 16; ++i) {
+        funcs.emplace_back(make_lambda({&sum, 1, 2, 3}));
+    }
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        funcs[i % 16](uintptr_t(i));
+    }
+    s.set_result(sum);
+}
+PICOBENCH(inplace_task_call);
+
+void std_function_call(picobench::state& s) {
+    uintptr_t sum = 0;
+    std::vector<std::function<void(uintptr_t)>> funcs(16, make_lambda({&sum, 1, 2, 3}));
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        funcs[i % 16](uintptr_t(i));
+    }
+    s.set_result(sum);
+}
+PICOBENCH(std_function_call);
+
+PICOBENCH_SUITE("create");
+
+// te_func_ptr doesn't own the callable, so the lambdas need storage of their own
+void te_func_ptr_create(picobench::state& s) {
+    uintptr_t sum = 0;
+    std::vector<lambda_t> storage;
+    storage.reserve(s.iterations());
+    std::vector<par::te_func_ptr<void(uintptr_t)>> queue;
+    queue.reserve(s.iterations());
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        auto& l = storage.emplace_back(make_lambda({&sum, uintptr_t(i), 2, 3}));
+        queue.emplace_back(l);
+    }
+    for (int i = 0; i < s.iterations(); ++i) {
+        queue[i](uintptr_t(i));
+    }
+    s.set_result(sum);
+}
+PICOBENCH(te_func_ptr_create);
+
+void inplace_task_create(picobench::state& s) {
+    uintptr_t sum = 0;
+    std::vector<par::inplace_task<void(uintptr_t)>> queue;
+    queue.reserve(s.iterations());
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        queue.emplace_back(make_lambda({&sum, uintptr_t(i), 2, 3}));
+    }
+    for (int i = 0; i < s.iterations(); ++i) {
+        queue[i](uintptr_t(i));
+    }
+    s.set_result(sum);
+}
+PICOBENCH(inplace_task_create);
+
+void std_function_create(picobench::state& s) {
+    uintptr_t sum = 0;
+    std::vector<std::function<void(uintptr_t)>> queue;
+    queue.reserve(s.iterations());
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        queue.emplace_back(make_lambda({&sum, uintptr_t(i), 2, 3}));
+    }
+    for (int i = 0; i < s.iterations(); ++i) {
+        queue[i](uintptr_t(i));
+    }
+    s.set_result(sum);
+}
+PICOBENCH(std_function_create);
+
+int main(int argc, char* argv[]) {
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({10'000, 100'000, 1'000'000});
+    r.parse_cmd_line(argc, argv);
+
+    return r.run();
+}
@@ -0,0 +1,124 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "bu-init.hpp"
+#include <par/phistogram.hpp>
+#include <omp.h>
+#include <atomic>
+#include <numeric>
+#include <vector>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// histograms of hashed values
+// the iterations are the number of values
+
+static constexpr uint32_t NUM_THREADS = 8;
+
+inline uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+template <size_t NumBins>
+struct bench {
+    static uint64_t bin(int i) {
+        return hash(uint32_t(i)) % NumBins;
+    }
+
+    static uint64_t result(const std::vector<uint64_t>& bins) {
+        // weighted, so that wrong bins are noticed
+        uint64_t r = 0;
+        for (size_t i = 0; i < bins.size(); ++i) {
+            r += bins[i] * (i + 1);
+        }
+        return r;
+    }
+
+    static void run_strategy(picobench::state& s, par::histogram_strategy strategy) {
+        std::vector<uint64_t> bins;
+        {
+            picobench::scope scope(s);
+            bins = par::phistogram({.max_par = NUM_THREADS}, 0, s.iterations(), NumBins, bin, strategy);
+        }
+        s.set_result(result(bins));
+    }
+
+    static void par_auto(picobench::state& s) {
+        run_strategy(s, par::histogram_auto);
+    }
+    static void par_private(picobench::state& s) {
+        run_strategy(s, par::histogram_private);
+    }
+    static void par_atomic(picobench::state& s) {
+        run_strategy(s, par::histogram_atomic);
+    }
+    static void par_hybrid(picobench::state& s) {
+        run_strategy(s, par::histogram_hybrid);
+    }
+
+    static void openmp_atomic(picobench::state& s) {
+        std::vector<uint64_t> bins(NumBins);
+        {
+            picobench::scope scope(s);
+            #pragma omp parallel for num_threads(NUM_THREADS) schedule(static)
+            for (int i = 0; i < s.iterations(); ++i) {
+                #pragma omp atomic
+                ++bins[bin(i)];
+            }
+        }
+        s.set_result(result(bins));
+    }
+
+    static void linear(picobench::state& s) {
+        std::vector<uint64_t> bins(NumBins);
+        {
+            picobench::scope scope(s);
+            for (int i = 0; i < s.iterations(); ++i) {
+                ++bins[bin(i)];
+            }
+        }
+        s.set_result(result(bins));
+    }
+};
+
+PICOBENCH_SUITE("16 bins");
+PICOBENCH(bench<16>::par_auto).label("par_auto");
+PICOBENCH(bench<16>::par_private).label("par_private");
+PICOBENCH(bench<16>::par_atomic).label("par_atomic");
+PICOBENCH(bench<16>::par_hybrid).label("par_hybrid");
+PICOBENCH(bench<16>::openmp_atomic).label("openmp_atomic");
+PICOBENCH(bench<16>::linear).label("linear");
+
+PICOBENCH_SUITE("1k bins");
+PICOBENCH(bench<1024>::par_auto).label("par_auto");
+PICOBENCH(bench<1024>::par_private).label("par_private");
+PICOBENCH(bench<1024>::par_atomic).label("par_atomic");
+PICOBENCH(bench<1024>::par_hybrid).label("par_hybrid");
+PICOBENCH(bench<1024>::openmp_atomic).label("openmp_atomic");
+PICOBENCH(bench<1024>::linear).label("linear");
+
+PICOBENCH_SUITE("1M bins");
+PICOBENCH(bench<1048576>::par_auto).label("par_auto");
+PICOBENCH(bench<1048576>::par_private).label("par_private");
+PICOBENCH(bench<1048576>::par_atomic).label("par_atomic");
+PICOBENCH(bench<1048576>::par_hybrid).label("par_hybrid");
+PICOBENCH(bench<1048576>::openmp_atomic).label("openmp_atomic");
+PICOBENCH(bench<1048576>::linear).label("linear");
+
+int main(int argc, char* argv[]) {
+    init_benchmark(NUM_THREADS);
+
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({100'000, 10'000'000});
+    r.parse_cmd_line(argc, argv);
+
+    return r.run();
+}
@@ -3,9 +3,9 @@
 //
 #include "bu-init.hpp"
 #include <par/pfor.hpp>
+#include <par/pfor_simd.hpp>
 #include <itlib/atomic.hpp>
 #include <omp.h>
-#include <complex>
 #include <numeric>
 
 #define PICOBENCH_IMPLEMENT
@@ -17,16 +17,49 @@ inline int mandelbrot(int x, int y, int size, int max_iter = 1000) {
     double cx = (x - size / 2.0) * 2.0 / size;
     double cy = (y - size / 2.0) * 2.0 / size;
 
-    std::complex<double> c(cx, cy);
-    std::complex<double> z = 0;
+    // the same arithmetic as mandelbrot_block (and no sqrt), so that the results match exactly
+    double zr = 0, zi = 0;
     int n = 0;
-    while (std::abs(z) <= 2.0 && n < max_iter) {
-        z = z * z + c;
+    while (n < max_iter) {
+        const double zr2 = zr * zr;
+        const double zi2 = zi * zi;
+        if (zr2 + zi2 > 4.0) break;
+        zi = zr * zi + zi * zr + cy;
+        zr = zr2 - zi2 + cx;
         ++n;
     }
     return n;
 }
 
+// the same computation for W pixels at once
+// the lanes are independent and the inner loops have a fixed trip count, so the compiler vectorizes them
+// finished lanes keep iterating (without counting) until all lanes are done
+template <size_t W>
+inline void mandelbrot_block(par::simd_block<W, int> b, int size, int* out, int max_iter = 1000) {
+    double cx[W], cy[W], zr[W] = {}, zi[W] = {};
+    int n[W] = {};
+    for (size_t l = 0; l < W; ++l) {
+        cx[l] = (b[l] % size - size / 2.0) * 2.0 / size;
+        cy[l] = (b[l] / size - size / 2.0) * 2.0 / size;
+    }
+    for (int it = 0; it < max_iter; ++it) {
+        int active = 0;
+        for (size_t l = 0; l < W; ++l) {
+            const double zr2 = zr[l] * zr[l];
+            const double zi2 = zi[l] * zi[l];
+            const int in = zr2 + zi2 <= 4.0;
+            n[l] += in;
+            active |= in;
+            zi[l] = zr[l] * zi[l] + zi[l] * zr[l] + cy[l];
+            zr[l] = zr2 - zi2 + cx[l];
+        }
+        if (!active) break;
+    }
+    for (size_t l = 0; l < W; ++l) {
+        out[b[l]] = n[l];
+    }
+}
+
 void par_nest(picobench::state& s) {
     const auto size = s.iterations();
     std::vector<int> output(size * size);
@@ -57,6 +90,25 @@ void par_manual_collapse(picobench::state& s) {
 }
 PICOBENCH(par_manual_collapse);
 
+void par_simd(picobench::state& s) {
+    const auto size = s.iterations();
+    std::vector<int> output(size * size);
+    {
+        picobench::scope scope(s);
+        // 8 ints of output per block, 16 per chunk, so that jobs write to separate cache lines
+        par::pfor_simd<8, 16>({.max_par = NUM_THREADS}, 0, size * size,
+            [&](par::simd_block<8, int> b) {
+                mandelbrot_block(b, size, output.data());
+            },
+            [&](int i) {
+                output[i] = mandelbrot(i % size, i / size, size);
+            }
+        );
+    }
+    s.set_result(std::accumulate(output.begin(), output.end(), 0));
+}
+PICOBENCH(par_simd);
+
 void openmp(picobench::state& s) {
     const auto size = s.iterations();
     std::vector<int> output(size * size);
@@ -0,0 +1,67 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "bu-init.hpp"
+#include <par/prun.hpp>
+#include <itlib/atomic.hpp>
+#include <omp.h>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// cost of launching empty parallel regions
+// the iterations are the number of regions
+
+static constexpr uint32_t NUM_THREADS = 8;
+
+void par_static(picobench::state& s) {
+    itlib::atomic_relaxed_counter<uintptr_t> cnt(0);
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        par::prun({.sched = par::schedule_static, .max_par = NUM_THREADS}, [&](uint32_t) {
+            ++cnt;
+        });
+    }
+    s.set_result(cnt.load());
+}
+PICOBENCH(par_static);
+
+void par_dynamic(picobench::state& s) {
+    itlib::atomic_relaxed_counter<uintptr_t> cnt(0);
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        par::prun({.max_par = NUM_THREADS}, [&](uint32_t) {
+            ++cnt;
+        });
+    }
+    s.set_result(cnt.load());
+}
+PICOBENCH(par_dynamic);
+
+void openmp(picobench::state& s) {
+    itlib::atomic_relaxed_counter<uintptr_t> cnt(0);
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        #pragma omp parallel num_threads(NUM_THREADS)
+        {
+            ++cnt;
+        }
+    }
+    s.set_result(cnt.load());
+}
+PICOBENCH(openmp);
+
+int main(int argc, char* argv[]) {
+    init_benchmark(NUM_THREADS);
+
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({100, 1000});
+    r.parse_cmd_line(argc, argv);
+
+    return r.run();
+}
@@ -0,0 +1,116 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "bu-init.hpp"
+#include <par/pfor.hpp>
+#include <itlib/atomic.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// latency of small requests while a batch job keeps the pool busy
+// the iterations are the number of requests
+// besides the mean time reported by picobench, the latency percentiles of each benchmark are printed at the end
+
+static constexpr uint32_t NUM_THREADS = 8;
+
+using clock_type = std::chrono::steady_clock;
+
+void spin_for(std::chrono::microseconds us) {
+    const auto end = clock_type::now() + us;
+    while (clock_type::now() < end);
+}
+
+// keep the global pool busy with a batch job until destroyed
+class batch_load {
+    std::atomic_bool m_stop = false;
+    std::thread m_thread;
+public:
+    explicit batch_load(par::priority_class prio)
+        : m_thread([this, prio]() {
+            while (!m_stop) {
+                par::pfor({.priority = prio}, 0, 64, [](int) {
+                    spin_for(std::chrono::microseconds(200));
+                });
+            }
+        })
+    {}
+
+    ~batch_load() {
+        m_stop = true;
+        m_thread.join();
+    }
+};
+
+std::map<std::string, std::vector<double>> latencies_us;
+
+void run_requests(picobench::state& s, par::priority_class prio, const char* name) {
+    itlib::atomic_relaxed_counter<uintptr_t> cnt(0);
+    auto& lat = latencies_us[name];
+
+    picobench::scope scope(s);
+    for (int i = 0; i < s.iterations(); ++i) {
+        const auto start = clock_type::now();
+        par::pfor({.max_par = NUM_THREADS, .priority = prio}, 0, 16, [&](int) {
+            spin_for(std::chrono::microseconds(5));
+            ++cnt;
+        });
+        lat.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - start).count());
+    }
+    s.set_result(cnt.load());
+}
+
+void no_load(picobench::state& s) {
+    run_requests(s, par::priority_high, "no_load");
+}
+PICOBENCH(no_load);
+
+void normal_under_normal_batch(picobench::state& s) {
+    batch_load load(par::priority_normal);
+    run_requests(s, par::priority_normal, "normal_under_normal_batch");
+}
+PICOBENCH(normal_under_normal_batch);
+
+void high_under_background_batch(picobench::state& s) {
+    batch_load load(par::priority_background);
+    run_requests(s, par::priority_high, "high_under_background_batch");
+}
+PICOBENCH(high_under_background_batch);
+
+double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    auto i = size_t(p * double(v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+int main(int argc, char* argv[]) {
+    init_benchmark(NUM_THREADS);
+
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({100, 1000});
+    r.parse_cmd_line(argc, argv);
+
+    auto ret = r.run();
+
+    printf("\nrequest latency (us):\n");
+    printf("%30s %10s %10s %10s\n", "", "p50", "p99", "max");
+    for (auto& [name, lat] : latencies_us) {
+        const auto p50 = percentile(lat, 0.5);
+        const auto p99 = percentile(lat, 0.99);
+        const auto max = percentile(lat, 1);
+        printf("%30s %10.1f %10.1f %10.1f\n", name.c_str(), p50, p99, max);
+    }
+
+    return ret;
+}
@@ -3,6 +3,7 @@
 //
 #include "bu-init.hpp"
 #include <par/pfor.hpp>
+#include <par/per_worker.hpp>
 #include <itlib/atomic.hpp>
 #include <omp.h>
 #include <random>
@@ -16,24 +17,28 @@ bool is_in_sphere(double x, double y, double z) {
     return x * x + y * y + z * z <= 1;
 }
 
-void bench_par(picobench::state& s) {
-    itlib::atomic_relaxed_counter<uintptr_t> accepted(0);
+struct sampler {
+    std::mt19937 rng;
+    std::uniform_real_distribution<double> dist;
 
-    picobench::scope scope(s);
+    explicit sampler(uint32_t seed)
+        : rng(seed)
+        , dist(-1, 1)
+    {}
 
-    struct sampler {
-        std::mt19937 rng;
-        std::uniform_real_distribution<double> dist;
+    sampler(const par::job_info& ji)
+        : sampler(ji.job_index)
+    {}
 
-        sampler(const par::job_info& ji)
-            : rng(ji.job_index)
-            , dist(-1, 1)
-        {}
+    double operator()() {
+        return dist(rng);
+    }
+};
 
-        double operator()() {
-            return dist(rng);
-        }
-    };
+void bench_par(picobench::state& s) {
+    itlib::atomic_relaxed_counter<uintptr_t> accepted(0);
+
+    picobench::scope scope(s);
 
     par::run_opts opts = {.sched = par::schedule_static, .max_par = NUM_THREADS};
     par::pfor<sampler>(opts, 0, s.iterations(), [&](int, sampler& samp) {
@@ -46,6 +51,45 @@ void bench_par(picobench::state& s) {
 }
 PICOBENCH(bench_par).label("par");
 
+// many small regions, as in a simulation step
+static constexpr int SAMPLES_PER_REGION = 1000;
+
+// the samplers are constructed in every job of every region
+void par_regions_job_data(picobench::state& s) {
+    itlib::atomic_relaxed_counter<uintptr_t> accepted(0);
+
+    picobench::scope scope(s);
+    for (int r = 0; r < s.iterations(); r += SAMPLES_PER_REGION) {
+        par::pfor<sampler>({.max_par = NUM_THREADS}, 0, SAMPLES_PER_REGION, [&](int, sampler& samp) {
+            if (is_in_sphere(samp(), samp(), samp())) {
+                ++accepted;
+            }
+        });
+    }
+    s.set_result(accepted.load());
+}
+PICOBENCH(par_regions_job_data);
+
+// the samplers are constructed once per thread
+void par_regions_per_worker(picobench::state& s) {
+    itlib::atomic_relaxed_counter<uintptr_t> accepted(0);
+    par::per_worker<sampler> samplers(par::thread_pool::global(), [](uint32_t slot) {
+        return sampler(slot);
+    });
+
+    picobench::scope scope(s);
+    for (int r = 0; r < s.iterations(); r += SAMPLES_PER_REGION) {
+        par::pfor({.max_par = NUM_THREADS}, 0, SAMPLES_PER_REGION, [&](int) {
+            auto& samp = samplers.local();
+            if (is_in_sphere(samp(), samp(), samp())) {
+                ++accepted;
+            }
+        });
+    }
+    s.set_result(accepted.load());
+}
+PICOBENCH(par_regions_per_worker);
+
 void openmp(picobench::state& s) {
     itlib::atomic_relaxed_counter<uintptr_t> accepted(0);
 
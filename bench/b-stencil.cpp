@@ -0,0 +1,155 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "bu-init.hpp"
+#include <par/pfor.hpp>
+#include <par/team.hpp>
+#include <omp.h>
+#include <vector>
+#include <numeric>
+#include <utility>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// time-stepping 1D heat stencil
+// the iterations are the number of time steps
+
+static constexpr uint32_t NUM_THREADS = 8;
+static constexpr int SIZE = 100'000;
+
+struct grid {
+    std::vector<float> cur, next;
+
+    grid() : cur(SIZE, 0), next(SIZE, 0) {
+        cur[SIZE / 2] = 1'000'000;
+        cur[SIZE / 4] = 1'000'000;
+    }
+
+    void step(int i) {
+        next[i] = cur[i] + 0.25f * (cur[i - 1] - 2 * cur[i] + cur[i + 1]);
+    }
+
+    void swap() {
+        std::swap(cur, next);
+    }
+
+    picobench::result_t result() const {
+        return picobench::result_t(std::accumulate(cur.begin(), cur.end(), 0.0));
+    }
+};
+
+void par_pfor(picobench::state& s) {
+    grid g;
+    {
+        picobench::scope scope(s);
+        for (int t = 0; t < s.iterations(); ++t) {
+            // a fork-join per step
+            par::pfor({.sched = par::schedule_static, .max_par = NUM_THREADS}, 1, SIZE - 1, [&](int i) {
+                g.step(i);
+            });
+            g.swap();
+        }
+    }
+    s.set_result(g.result());
+}
+PICOBENCH(par_pfor);
+
+void par_dynamic(picobench::state& s) {
+    grid g;
+    {
+        picobench::scope scope(s);
+        for (int t = 0; t < s.iterations(); ++t) {
+            // indices land on different workers in each step
+            par::pfor({.max_par = NUM_THREADS}, par::range(1, SIZE - 1).job_chunk(1024), [&](int i) {
+                g.step(i);
+            });
+            g.swap();
+        }
+    }
+    s.set_result(g.result());
+}
+PICOBENCH(par_dynamic);
+
+void par_affinity(picobench::state& s) {
+    grid g;
+    par::affinity_partitioner affinity;
+    {
+        picobench::scope scope(s);
+        for (int t = 0; t < s.iterations(); ++t) {
+            // blocks go to the workers which ran them in the previous step, where their part of the grid is cached
+            par::pfor({.sched = par::schedule_affinity, .max_par = NUM_THREADS, .affinity = &affinity}, 1, SIZE - 1, [&](int i) {
+                g.step(i);
+            });
+            g.swap();
+        }
+    }
+    s.set_result(g.result());
+}
+PICOBENCH(par_affinity);
+
+void par_team(picobench::state& s) {
+    grid g;
+    {
+        picobench::scope scope(s);
+        par::pteam({.max_par = NUM_THREADS}, [&](par::team& team) {
+            for (int t = 0; t < s.iterations(); ++t) {
+                team.pfor(1, SIZE - 1, [&](int i) {
+                    g.step(i);
+                });
+                team.single([&]() {
+                    g.swap();
+                });
+            }
+        });
+    }
+    s.set_result(g.result());
+}
+PICOBENCH(par_team);
+
+void openmp(picobench::state& s) {
+    grid g;
+    {
+        picobench::scope scope(s);
+        #pragma omp parallel num_threads(NUM_THREADS)
+        {
+            for (int t = 0; t < s.iterations(); ++t) {
+                #pragma omp for schedule(static)
+                for (int i = 1; i < SIZE - 1; ++i) {
+                    g.step(i);
+                }
+                #pragma omp single
+                g.swap();
+            }
+        }
+    }
+    s.set_result(g.result());
+}
+PICOBENCH(openmp);
+
+void linear(picobench::state& s) {
+    grid g;
+    {
+        picobench::scope scope(s);
+        for (int t = 0; t < s.iterations(); ++t) {
+            for (int i = 1; i < SIZE - 1; ++i) {
+                g.step(i);
+            }
+            g.swap();
+        }
+    }
+    s.set_result(g.result());
+}
+PICOBENCH(linear);
+
+int main(int argc, char* argv[]) {
+    init_benchmark(NUM_THREADS);
+
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({100, 1000});
+    r.parse_cmd_line(argc, argv);
+
+    return r.run();
+}
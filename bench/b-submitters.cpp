@@ -0,0 +1,98 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "bu-init.hpp"
+#include <par/pfor.hpp>
+#include <itlib/atomic.hpp>
+#include <thread>
+#include <vector>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// throughput of concurrent external callers (like request threads of a server) submitting regions to the same pool
+// the iterations are the number of callers, each of which submits REGIONS_PER_CALLER regions
+// the work grows with the number of callers, compare the times with serial, where callers don't share anything
+
+static constexpr uint32_t NUM_THREADS = 8;
+static constexpr int REGIONS_PER_CALLER = 200;
+static constexpr int ITEMS_PER_REGION = 64;
+
+uintptr_t work(int i) {
+    uintptr_t h = uintptr_t(i);
+    for (int j = 0; j < 200; ++j) {
+        h = h * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    return h >> 60;
+}
+
+template <typename Region>
+void run_callers(picobench::state& s, Region region) {
+    itlib::atomic_relaxed_counter<uintptr_t> cnt(0);
+    std::vector<std::thread> callers;
+    callers.reserve(s.iterations());
+
+    picobench::scope scope(s);
+    for (int c = 0; c < s.iterations(); ++c) {
+        callers.emplace_back([&]() {
+            uintptr_t sum = 0;
+            for (int r = 0; r < REGIONS_PER_CALLER; ++r) {
+                sum += region();
+            }
+            cnt += sum;
+        });
+    }
+    for (auto& t : callers) {
+        t.join();
+    }
+    s.set_result(cnt.load());
+}
+
+// no parallelism, each caller does its own work
+void serial(picobench::state& s) {
+    run_callers(s, []() {
+        uintptr_t sum = 0;
+        for (int i = 0; i < ITEMS_PER_REGION; ++i) {
+            sum += work(i);
+        }
+        return sum;
+    });
+}
+PICOBENCH(serial);
+
+// regions which use the entire pool
+void par_full(picobench::state& s) {
+    run_callers(s, []() {
+        itlib::atomic_relaxed_counter<uintptr_t> sum(0);
+        par::pfor({}, 0, ITEMS_PER_REGION, [&](int i) {
+            sum += work(i);
+        });
+        return sum.load();
+    });
+}
+PICOBENCH(par_full);
+
+// regions which use a part of the pool, so that many of them are pending at the same time
+void par_partial(picobench::state& s) {
+    run_callers(s, []() {
+        itlib::atomic_relaxed_counter<uintptr_t> sum(0);
+        par::pfor({.max_par = 3}, 0, ITEMS_PER_REGION, [&](int i) {
+            sum += work(i);
+        });
+        return sum.load();
+    });
+}
+PICOBENCH(par_partial);
+
+int main(int argc, char* argv[]) {
+    init_benchmark(NUM_THREADS);
+
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({1, 2, 4, 8, 16, 32, 64});
+    r.set_default_samples(3);
+    r.parse_cmd_line(argc, argv);
+
+    return r.run();
+}
@@ -0,0 +1,110 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/prun.hpp>
+#include <itlib/atomic.hpp>
+#include <chrono>
+#include <thread>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// cost of launching empty regions on pools whose workers are asleep
+// (as with regions which come every few milliseconds, like the frames of a game or the requests of a server)
+// the iterations are the number of regions
+// the workers are given time to fall asleep before each region, which is not included in the time
+// "tree" pools wake up their workers in a tree with the default fan-out, "linear" ones have the caller wake them all up
+
+template <uint32_t N, uint32_t Fanout>
+par::thread_pool& pool() {
+    static par::thread_pool p("wake", N, {.auto_scale = false, .wake_up_fanout = Fanout});
+    return p;
+}
+
+static constexpr uint32_t tree = par::thread_pool::scaling_opts{}.wake_up_fanout;
+static constexpr uint32_t linear = 0;
+
+void let_workers_sleep() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+template <uint32_t N, uint32_t Fanout>
+void par_static_impl(picobench::state& s) {
+    itlib::atomic_relaxed_counter<uintptr_t> cnt(0);
+    auto& p = pool<N, Fanout>();
+
+    for (int i = 0; i < s.iterations(); ++i) {
+        let_workers_sleep();
+        s.start_timer();
+        par::prun(p, {.sched = par::schedule_static}, [&](uint32_t) {
+            ++cnt;
+        });
+        s.stop_timer();
+    }
+    s.set_result(cnt.load() / (N + 1));
+}
+
+template <uint32_t N>
+void par_static_linear(picobench::state& s) {
+    par_static_impl<N, linear>(s);
+}
+
+template <uint32_t N>
+void par_static_tree(picobench::state& s) {
+    par_static_impl<N, tree>(s);
+}
+
+template <uint32_t N, uint32_t Fanout>
+void par_dynamic_impl(picobench::state& s) {
+    itlib::atomic_relaxed_counter<uintptr_t> cnt(0);
+    auto& p = pool<N, Fanout>();
+
+    for (int i = 0; i < s.iterations(); ++i) {
+        let_workers_sleep();
+        s.start_timer();
+        par::prun(p, {}, [&](uint32_t) {
+            ++cnt;
+        });
+        s.stop_timer();
+    }
+    s.set_result(cnt.load() / (N + 1));
+}
+
+template <uint32_t N>
+void par_dynamic_linear(picobench::state& s) {
+    par_dynamic_impl<N, linear>(s);
+}
+
+template <uint32_t N>
+void par_dynamic_tree(picobench::state& s) {
+    par_dynamic_impl<N, tree>(s);
+}
+
+PICOBENCH_SUITE("8 workers");
+PICOBENCH(par_static_linear<8>).label("static linear");
+PICOBENCH(par_static_tree<8>).label("static tree");
+PICOBENCH(par_dynamic_linear<8>).label("dynamic linear");
+PICOBENCH(par_dynamic_tree<8>).label("dynamic tree");
+
+PICOBENCH_SUITE("32 workers");
+PICOBENCH(par_static_linear<32>).label("static linear");
+PICOBENCH(par_static_tree<32>).label("static tree");
+PICOBENCH(par_dynamic_linear<32>).label("dynamic linear");
+PICOBENCH(par_dynamic_tree<32>).label("dynamic tree");
+
+PICOBENCH_SUITE("128 workers");
+PICOBENCH(par_static_linear<128>).label("static linear");
+PICOBENCH(par_static_tree<128>).label("static tree");
+PICOBENCH(par_dynamic_linear<128>).label("dynamic linear");
+PICOBENCH(par_dynamic_tree<128>).label("dynamic tree");
+
+int main(int argc, char* argv[]) {
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({20, 100});
+    r.set_default_samples(3);
+    r.parse_cmd_line(argc, argv);
+
+    return r.run();
+}
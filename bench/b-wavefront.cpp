@@ -0,0 +1,138 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "bu-init.hpp"
+#include <par/pwavefront.hpp>
+#include <par/pfor.hpp>
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+
+// edit distance of two strings with the full dynamic programming table split into tiles
+// the iterations are the length of the strings
+
+static constexpr uint32_t NUM_THREADS = 8;
+static constexpr size_t TILE = 128;
+
+std::string make_string(size_t size, uint32_t seed) {
+    std::string ret(size, 'a');
+    for (auto& c : ret) {
+        seed = seed * 1664525 + 1013904223;
+        c = char('a' + (seed >> 28) % 4);
+    }
+    return ret;
+}
+
+struct table {
+    std::string a, b;
+    size_t w;
+    std::vector<uint32_t> d;
+    uint32_t tile_rows, tile_cols;
+
+    explicit table(int size)
+        : a(make_string(size, 1))
+        , b(make_string(size, 2))
+        , w(b.size() + 1)
+        , d((a.size() + 1) * w)
+        , tile_rows(uint32_t((a.size() + TILE) / TILE))
+        , tile_cols(uint32_t((b.size() + TILE) / TILE))
+    {}
+
+    void tile(uint32_t ti, uint32_t tj) {
+        const size_t iend = std::min(a.size() + 1, (ti + 1) * TILE);
+        const size_t jend = std::min(w, (tj + 1) * TILE);
+        for (size_t i = ti * TILE; i < iend; ++i) {
+            for (size_t j = tj * TILE; j < jend; ++j) {
+                if (i == 0 || j == 0) {
+                    d[i * w + j] = uint32_t(i + j);
+                    continue;
+                }
+                d[i * w + j] = std::min({
+                    d[(i - 1) * w + j] + 1,
+                    d[i * w + j - 1] + 1,
+                    d[(i - 1) * w + j - 1] + (a[i - 1] != b[j - 1]),
+                });
+            }
+        }
+    }
+
+    // tiles of anti-diagonal k
+    uint32_t diag_begin(uint32_t k) const { return k < tile_cols ? 0 : k - tile_cols + 1; }
+    uint32_t diag_end(uint32_t k) const { return std::min(k + 1, tile_rows); }
+    uint32_t num_diags() const { return tile_rows + tile_cols - 1; }
+};
+
+void serial(picobench::state& s) {
+    table t(s.iterations());
+    {
+        picobench::scope scope(s);
+        for (uint32_t ti = 0; ti < t.tile_rows; ++ti) {
+            for (uint32_t tj = 0; tj < t.tile_cols; ++tj) {
+                t.tile(ti, tj);
+            }
+        }
+    }
+    s.set_result(t.d.back());
+}
+PICOBENCH(serial);
+
+void par_diagonals(picobench::state& s) {
+    table t(s.iterations());
+    {
+        picobench::scope scope(s);
+        for (uint32_t k = 0; k < t.num_diags(); ++k) {
+            // a fork-join per anti-diagonal
+            par::pfor({.max_par = NUM_THREADS}, t.diag_begin(k), t.diag_end(k), [&](uint32_t ti) {
+                t.tile(ti, k - ti);
+            });
+        }
+    }
+    s.set_result(t.d.back());
+}
+PICOBENCH(par_diagonals);
+
+void par_pwavefront(picobench::state& s) {
+    table t(s.iterations());
+    {
+        picobench::scope scope(s);
+        par::pwavefront({.max_par = NUM_THREADS}, t.tile_rows, t.tile_cols, [&](uint32_t ti, uint32_t tj) {
+            t.tile(ti, tj);
+        });
+    }
+    s.set_result(t.d.back());
+}
+PICOBENCH(par_pwavefront);
+
+void openmp_diagonals(picobench::state& s) {
+    table t(s.iterations());
+    {
+        picobench::scope scope(s);
+        for (uint32_t k = 0; k < t.num_diags(); ++k) {
+            const int begin = int(t.diag_begin(k));
+            const int end = int(t.diag_end(k));
+            #pragma omp parallel for num_threads(NUM_THREADS) schedule(dynamic)
+            for (int ti = begin; ti < end; ++ti) {
+                t.tile(uint32_t(ti), uint32_t(k - ti));
+            }
+        }
+    }
+    s.set_result(t.d.back());
+}
+PICOBENCH(openmp_diagonals);
+
+int main(int argc, char* argv[]) {
+    init_benchmark(NUM_THREADS);
+
+    picobench::runner r;
+    r.set_compare_results_across_samples(true);
+    r.set_compare_results_across_benchmarks(true);
+    r.set_default_state_iterations({1000, 2000, 4000});
+    r.parse_cmd_line(argc, argv);
+
+    return r.run();
+}
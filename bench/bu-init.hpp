@@ -14,10 +14,7 @@ inline void init_benchmark(uint32_t num_threads) {
 
     std::atomic_uint32_t counter{0};
 
-    // warm up par
-    par::prun({.sched = par::schedule_static}, [&](uint32_t) {
-        ++counter;
-    });
+    par::thread_pool::global().warm_up();
 
     // warm up OpenMP
     #pragma omp parallel for num_threads(num_threads) schedule(static)
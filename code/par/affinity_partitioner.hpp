@@ -0,0 +1,120 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "thread_pool.hpp"
+#include "bits/imath.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace par {
+
+// the memory of schedule_affinity
+// loops which are run many times over the same range (like the steps of a simulation) pass the same partitioner
+// in run_opts::affinity
+// the range is split into blocks and the partitioner remembers which worker ran each block, so that the next time
+// the block is handed to the same worker first, where the data it touched is still in the cache
+// workers which run out of their own blocks steal others for balance
+// the equivalent of tbb::affinity_partitioner
+// a partitioner must not be used by concurrent loops
+class affinity_partitioner {
+public:
+    explicit affinity_partitioner(uint32_t blocks_per_job = 4)
+        : m_blocks_per_job(blocks_per_job ? blocks_per_job : 1)
+    {}
+
+    affinity_partitioner(const affinity_partitioner&) = delete;
+    affinity_partitioner& operator=(const affinity_partitioner&) = delete;
+
+    // forget the previous assignment of blocks
+    void reset() {
+        m_size = 0;
+    }
+
+    // the rest is used by the loops
+
+    // prepare the blocks of a loop over [0, size)
+    // the assignment is kept if the size and the number of jobs are the same as in the previous loop
+    void begin_loop(const thread_pool& pool, uint64_t size, uint32_t num_jobs) {
+        const uint32_t num_slots = pool.max_threads() + 1; // workers and callers
+        if (size != m_size || num_jobs != m_num_jobs || num_slots != m_num_slots) {
+            m_size = size;
+            m_num_jobs = num_jobs;
+            m_num_slots = num_slots;
+            m_block_size = std::max(uint64_t(1), divide_round_up(size, uint64_t(num_jobs) * m_blocks_per_job));
+            m_num_blocks = uint32_t(divide_round_up(size, m_block_size));
+            m_owners.assign(m_num_blocks, no_slot);
+            m_claimed = std::make_unique<std::atomic_bool[]>(m_num_blocks);
+            m_slot_blocks.resize(m_num_blocks);
+            m_slot_begin.resize(m_num_slots + 1);
+        }
+
+        for (uint32_t b = 0; b < m_num_blocks; ++b) {
+            m_claimed[b].store(false, std::memory_order_relaxed);
+        }
+
+        // group the blocks by their previous owner
+        std::fill(m_slot_begin.begin(), m_slot_begin.end(), 0);
+        for (auto o : m_owners) {
+            if (o != no_slot) ++m_slot_begin[o + 1];
+        }
+        for (uint32_t s = 0; s < m_num_slots; ++s) {
+            m_slot_begin[s + 1] += m_slot_begin[s];
+        }
+        std::vector<uint32_t> pos(m_slot_begin.begin(), m_slot_begin.end() - 1);
+        for (uint32_t b = 0; b < m_num_blocks; ++b) {
+            if (m_owners[b] != no_slot) {
+                m_slot_blocks[pos[m_owners[b]]++] = b;
+            }
+        }
+    }
+
+    // call func(begin, end) for the blocks run by the current thread until it returns false or there are none left
+    template <typename Func>
+    void run_blocks(const thread_pool& pool, Func&& func) {
+        const uint32_t slot = pool.current_worker_index().value_or(m_num_slots - 1);
+
+        auto run = [&](uint32_t b) {
+            if (m_claimed[b].load(std::memory_order_relaxed)) return true;
+            if (m_claimed[b].exchange(true, std::memory_order_relaxed)) return true;
+            m_owners[b] = slot;
+            const uint64_t begin = b * m_block_size;
+            return func(begin, std::min(begin + m_block_size, m_size));
+        };
+
+        // own blocks first
+        for (uint32_t i = m_slot_begin[slot]; i < m_slot_begin[slot + 1]; ++i) {
+            if (!run(m_slot_blocks[i])) return;
+        }
+
+        // steal, starting from a different place for each slot
+        // on the first loop this gives each worker a contiguous part of the range
+        const uint32_t start = uint32_t(uint64_t(slot) * m_num_blocks / m_num_slots);
+        for (uint32_t i = 0; i < m_num_blocks; ++i) {
+            if (!run((start + i) % m_num_blocks)) return;
+        }
+    }
+
+private:
+    static constexpr uint32_t no_slot = ~uint32_t(0);
+
+    const uint32_t m_blocks_per_job;
+
+    uint64_t m_size = 0;
+    uint32_t m_num_jobs = 0;
+    uint32_t m_num_slots = 0;
+    uint64_t m_block_size = 1;
+    uint32_t m_num_blocks = 0;
+
+    std::vector<uint32_t> m_owners; // the slot which ran each block in the previous loop
+    std::unique_ptr<std::atomic_bool[]> m_claimed;
+
+    // blocks grouped by their previous owner, the blocks of slot s are [m_slot_begin[s], m_slot_begin[s + 1])
+    std::vector<uint32_t> m_slot_blocks;
+    std::vector<uint32_t> m_slot_begin;
+};
+
+} // namespace par
@@ -4,6 +4,10 @@
 #pragma once
 #include <cstddef>
 
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
 // Why not use std::hardware_*structive_interference_size?
 // The reason is that gcc and clang detect the use of them in headers and emit warnings in this case
 // and rightfully so. It's theoretically dangerous to use this in a public ABI, especially in the light of
@@ -43,4 +47,17 @@ inline constexpr size_t cache_line_size =
 inline constexpr size_t alignment_to_avoid_false_sharing = cache_line_size;
 inline constexpr size_t min_cache_line_size_for_true_sharing = cache_line_size;
 
+// hint to the cpu that we're in a spin-wait loop
+inline void relax() noexcept {
+#if defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(_M_ARM64)
+    __yield();
+#elif defined(__aarch64__) || defined(__arm64__)
+    asm volatile("yield");
+#endif
+}
+
 } // namespace par::cpu
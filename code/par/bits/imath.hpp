@@ -3,6 +3,7 @@
 //
 #pragma once
 #include <concepts>
+#include <type_traits>
 
 namespace par {
 
@@ -11,4 +12,16 @@ constexpr T divide_round_up(T dividend, T divisor) {
     return (dividend + divisor - 1) / divisor;
 }
 
+// also works for unsigned types and the minimum value of signed ones
+template <std::integral T>
+constexpr std::make_unsigned_t<T> unsigned_abs(T value) {
+    using U = std::make_unsigned_t<T>;
+    if constexpr (std::is_signed_v<T>) {
+        return value < 0 ? U(0) - U(value) : U(value);
+    }
+    else {
+        return value;
+    }
+}
+
 } // namespace par
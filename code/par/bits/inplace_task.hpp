@@ -0,0 +1,126 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// owning move-only type-erased function with a fixed inplace buffer
+// unlike te_func_ptr it owns the callable, so it can outlive the scope in which it was created
+// unlike std::function it never allocates: callables which don't fit in the buffer are a compilation error
+
+namespace par {
+
+template <typename Func, size_t Capacity = 48>
+class inplace_task;
+
+template <typename Ret, typename... Args, size_t Capacity>
+class inplace_task<Ret(Args...), Capacity> {
+    struct ops {
+        Ret(*invoke)(void*, Args...);
+
+        // move-construct the callable in dst and destroy the one in src
+        // nullptr for trivially copyable callables, which are relocated with memcpy
+        void(*relocate)(void* dst, void* src) noexcept;
+
+        // nullptr for trivially destructible callables
+        void(*destroy)(void*) noexcept;
+    };
+
+    template <typename F>
+    static constexpr ops ops_for = {
+        [](void* payload, Args... args) -> Ret {
+            return (*static_cast<F*>(payload))(std::forward<Args>(args)...);
+        },
+        std::is_trivially_copyable_v<F> ? nullptr : +[](void* dst, void* src) noexcept {
+            F* f = static_cast<F*>(src);
+            new (dst) F(std::move(*f));
+            f->~F();
+        },
+        std::is_trivially_destructible_v<F> ? nullptr : +[](void* payload) noexcept {
+            static_cast<F*>(payload)->~F();
+        },
+    };
+
+    alignas(std::max_align_t) std::byte m_buf[Capacity];
+    const ops* m_ops = nullptr;
+
+    void relocate_from(inplace_task& other) noexcept {
+        m_ops = other.m_ops;
+        if (!m_ops) return;
+        if (m_ops->relocate) {
+            m_ops->relocate(m_buf, other.m_buf);
+        }
+        else {
+            std::memcpy(m_buf, other.m_buf, Capacity);
+        }
+        other.m_ops = nullptr;
+    }
+
+public:
+    static constexpr size_t capacity = Capacity;
+
+    inplace_task() noexcept = default;
+    inplace_task(std::nullptr_t) noexcept {}
+
+    template <typename F>
+        requires (!std::is_same_v<std::remove_cvref_t<F>, inplace_task> && std::is_invocable_r_v<Ret, F&, Args...>)
+    inplace_task(F&& func) {
+        reset(std::forward<F>(func));
+    }
+
+    inplace_task(const inplace_task&) = delete;
+    inplace_task& operator=(const inplace_task&) = delete;
+
+    inplace_task(inplace_task&& other) noexcept {
+        relocate_from(other);
+    }
+
+    inplace_task& operator=(inplace_task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            relocate_from(other);
+        }
+        return *this;
+    }
+
+    ~inplace_task() {
+        reset();
+    }
+
+    template <typename F>
+    void reset(F&& func) {
+        using FT = std::decay_t<F>;
+        static_assert(sizeof(FT) <= Capacity, "callable is too big for inplace_task");
+        static_assert(alignof(FT) <= alignof(std::max_align_t), "callable is overaligned for inplace_task");
+        static_assert(std::is_nothrow_move_constructible_v<FT>, "inplace_task callables must be nothrow movable");
+        reset();
+        new (m_buf) FT(std::forward<F>(func));
+        m_ops = &ops_for<FT>;
+    }
+
+    void reset() noexcept {
+        if (m_ops && m_ops->destroy) {
+            m_ops->destroy(m_buf);
+        }
+        m_ops = nullptr;
+    }
+
+    void reset(std::nullptr_t) noexcept {
+        reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return !!m_ops;
+    }
+
+    template <typename... CallArgs>
+    Ret operator()(CallArgs&&... args) {
+        return m_ops->invoke(m_buf, std::forward<CallArgs>(args)...);
+    }
+};
+
+} // namespace par
@@ -0,0 +1,41 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "bits/cpu.hpp"
+#include <splat/inline.h>
+#include <atomic>
+
+#include <splat/warnings.h>
+PRAGMA_WARNING_PUSH
+DISABLE_MSVC_WARNING(4324)
+
+namespace par {
+
+// stop a loop early
+// pass a pointer to it in run_opts::cancel and call cancel() from any iteration (or any other thread)
+// the loop stops handing out new iterations (or chunks of iterations when they are specified)
+// iterations which have already been started are completed
+// tokens are not reset by loops and a cancelled token cancels any loop it's passed to
+class cancellation_token {
+    // on its own cache line, as it's polled by all jobs
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_bool m_cancelled = false;
+public:
+    void cancel() noexcept {
+        m_cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    bool cancelled() const noexcept {
+        return m_cancelled.load(std::memory_order_relaxed);
+    }
+};
+
+namespace impl {
+FORCE_INLINE bool is_cancelled(const cancellation_token* token) {
+    return token && token->cancelled();
+}
+} // namespace impl
+
+} // namespace par
+
+PRAGMA_WARNING_POP
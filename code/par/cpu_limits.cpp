@@ -0,0 +1,172 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "cpu_limits.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <string_view>
+#include <thread>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sched.h>
+#endif
+
+#include <splat/warnings.h>
+DISABLE_MSVC_WARNING(4996) // getenv
+
+namespace par {
+
+namespace {
+
+std::optional<uint64_t> parse_uint(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) str.remove_prefix(1);
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t' || str.back() == '\n')) str.remove_suffix(1);
+    uint64_t ret;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), ret);
+    if (ec != std::errc{} || end != str.data() + str.size()) return std::nullopt;
+    return ret;
+}
+
+std::optional<std::string> read_line(const std::string& path) {
+    std::ifstream f(path);
+    std::string line;
+    if (!f || !std::getline(f, line)) return std::nullopt;
+    return line;
+}
+
+// quota and period in the same units to whole cpus
+std::optional<uint32_t> quota_to_cpus(std::optional<uint64_t> quota, std::optional<uint64_t> period) {
+    if (!quota || !period || !*period) return std::nullopt;
+    return uint32_t(std::clamp(*quota / *period, uint64_t(1), uint64_t(UINT32_MAX)));
+}
+
+// v2: cpu.max is "$MAX $PERIOD", where $MAX is "max" for no quota
+std::optional<uint32_t> read_cpu_max(const std::string& dir) {
+    const auto line = read_line(dir + "/cpu.max");
+    if (!line) return std::nullopt;
+    const std::string_view l = *line;
+    const auto space = l.find(' ');
+    if (space == std::string_view::npos) return std::nullopt;
+    return quota_to_cpus(parse_uint(l.substr(0, space)), parse_uint(l.substr(space + 1)));
+}
+
+// v1: cpu.cfs_quota_us is -1 for no quota
+std::optional<uint32_t> read_cfs_quota(const std::string& dir) {
+    const auto quota = read_line(dir + "/cpu.cfs_quota_us");
+    if (!quota) return std::nullopt;
+    const auto period = read_line(dir + "/cpu.cfs_period_us");
+    if (!period) return std::nullopt;
+    return quota_to_cpus(parse_uint(*quota), parse_uint(*period));
+}
+
+void min_quota(std::optional<uint32_t>& ret, std::optional<uint32_t> q) {
+    if (q && (!ret || *q < *ret)) ret = q;
+}
+
+// the lowest quota of the cgroup at path and its ancestors under mount
+// in containers only a part of the hierarchy may be mounted, so the path may not exist, but its ancestors do
+template <typename Read>
+void min_hierarchy_quota(std::optional<uint32_t>& ret, const std::string& mount, std::string_view path, Read read) {
+    while (true) {
+        while (!path.empty() && path.back() == '/') path.remove_suffix(1);
+        min_quota(ret, read(mount + std::string(path)));
+        if (path.empty()) return;
+        path = path.substr(0, path.rfind('/') + 1);
+    }
+}
+
+std::optional<uint32_t> env_uint(const char* name) {
+    if (!name) return std::nullopt;
+    const char* value = std::getenv(name);
+    if (!value) return std::nullopt;
+    const auto ret = parse_uint(value);
+    if (!ret || *ret > UINT32_MAX) return std::nullopt;
+    return uint32_t(*ret);
+}
+
+} // namespace
+
+std::optional<uint32_t> affinity_cpus() {
+#if defined(__linux__)
+    // the set may have to be larger than cpu_set_t on machines with many cpus
+    for (size_t num_cpus = CPU_SETSIZE; num_cpus <= 1024 * 1024; num_cpus *= 2) {
+        cpu_set_t* set = CPU_ALLOC(num_cpus);
+        if (!set) break;
+        const size_t size = CPU_ALLOC_SIZE(num_cpus);
+        const bool ok = sched_getaffinity(0, size, set) == 0;
+        const int err = errno;
+        const int count = ok ? CPU_COUNT_S(size, set) : 0;
+        CPU_FREE(set);
+        if (ok) return uint32_t(count);
+        if (err != EINVAL) break;
+    }
+#endif
+    return std::nullopt;
+}
+
+std::optional<uint32_t> cgroup_cpu_quota(const cpu_limits_opts& opts) {
+    std::ifstream f(opts.proc_self_cgroup);
+    if (!f) return std::nullopt;
+
+    std::optional<uint32_t> ret;
+
+    // lines are "$ID:$CONTROLLERS:$PATH"
+    // v2 has a single line with id 0 and no controllers, v1 has a line per hierarchy
+    std::string line;
+    while (std::getline(f, line)) {
+        const std::string_view l = line;
+        const auto c1 = l.find(':');
+        if (c1 == std::string_view::npos) continue;
+        const auto c2 = l.find(':', c1 + 1);
+        if (c2 == std::string_view::npos) continue;
+        const auto id = l.substr(0, c1);
+        const auto controllers = l.substr(c1 + 1, c2 - c1 - 1);
+        const auto path = l.substr(c2 + 1);
+
+        if (id == "0" && controllers.empty()) {
+            min_hierarchy_quota(ret, opts.cgroup_root, path, read_cpu_max);
+            continue;
+        }
+
+        // v1 cpu controller, possibly co-mounted with others (like "cpu,cpuacct")
+        bool has_cpu = false;
+        for (auto rest = controllers; !rest.empty(); ) {
+            const auto comma = rest.find(',');
+            if (rest.substr(0, comma) == "cpu") has_cpu = true;
+            rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+        }
+        if (!has_cpu) continue;
+
+        // the mount is named after the controllers, but often there's also a "cpu" symlink
+        const std::string base = opts.cgroup_root + '/';
+        min_hierarchy_quota(ret, base + std::string(controllers), path, read_cfs_quota);
+        if (controllers != "cpu") {
+            min_hierarchy_quota(ret, base + "cpu", path, read_cfs_quota);
+        }
+    }
+
+    return ret;
+}
+
+uint32_t available_cpus(const cpu_limits_opts& opts) {
+    uint32_t ret = std::thread::hardware_concurrency();
+    if (ret == 0) ret = UINT32_MAX; // unknown, rely on the limits below
+    if (auto a = affinity_cpus(); a && *a) ret = std::min(ret, *a);
+    if (auto q = cgroup_cpu_quota(opts)) ret = std::min(ret, *q);
+    if (ret == UINT32_MAX) ret = 1;
+    return ret;
+}
+
+uint32_t default_num_threads(const default_threads_opts& opts) {
+    // more threads would make the pool constructor throw
+    if (auto n = env_uint(opts.num_threads_env)) return std::min(*n, thread_pool::max_threads_limit);
+    const auto reserved = env_uint(opts.reserved_threads_env).value_or(opts.reserved_threads);
+    const auto cpus = available_cpus(opts.limits);
+    return cpus > reserved ? std::min(cpus - reserved, thread_pool::max_threads_limit) : 0;
+}
+
+} // namespace par
@@ -0,0 +1,56 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "api.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// the number of cpus a process can actually use
+// std::thread::hardware_concurrency() is the number of cpus of the machine, but a process may be restricted to
+// fewer by its affinity mask (taskset, cpusets) or by a cgroup cpu quota (containers)
+
+namespace par {
+
+struct cpu_limits_opts {
+    // mount point of the cgroup filesystem
+    // for cgroup v1 the controllers are expected in subdirectories (like cgroup_root/cpu,cpuacct)
+    std::string cgroup_root = "/sys/fs/cgroup";
+
+    // the cgroups of the process
+    std::string proc_self_cgroup = "/proc/self/cgroup";
+};
+
+// the number of cpus in the affinity mask of the process
+// empty if not supported on the platform
+PAR_API std::optional<uint32_t> affinity_cpus();
+
+// the cpu quota of the cgroups of the process (cpu.max in v2, cpu.cfs_quota_us in v1) in whole cpus
+// the quota is rounded down (at least one cpu), as more threads than that get throttled
+// if several cgroups in the hierarchy have a quota, the lowest one is returned
+// empty if there is no quota, or no cgroups
+PAR_API std::optional<uint32_t> cgroup_cpu_quota(const cpu_limits_opts& opts = {});
+
+// the minimum of the hardware concurrency, affinity_cpus() and cgroup_cpu_quota(), at least one
+PAR_API uint32_t available_cpus(const cpu_limits_opts& opts = {});
+
+struct default_threads_opts {
+    // threads left for the rest of the process (like the main thread and i/o threads)
+    uint32_t reserved_threads = 2;
+
+    cpu_limits_opts limits;
+
+    // environment variables which override the result and reserved_threads respectively
+    // nullptr to ignore
+    const char* num_threads_env = "PAR_NUM_THREADS";
+    const char* reserved_threads_env = "PAR_RESERVED_THREADS";
+};
+
+// the number of worker threads of a pool which uses all available cpus: available_cpus() - reserved_threads
+// unless overridden by the environment variable opts.num_threads_env
+// either way, at most thread_pool::max_threads_limit
+// this is the size of the global thread pool unless it's initialized explicitly
+PAR_API uint32_t default_num_threads(const default_threads_opts& opts = {});
+
+} // namespace par
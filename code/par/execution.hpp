@@ -0,0 +1,264 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "thread_pool.hpp"
+#include "pchunk.hpp"
+#include <stdexec/execution.hpp>
+#include <atomic>
+#include <concepts>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+// sender/receiver (P2300) integration through stdexec
+// par doesn't depend on stdexec, include this header only if you do (it's tested with stdexec nvhpc-24.09)
+//
+// par::scheduler models the scheduler concept for a thread pool:
+// * schedule() completes on a worker of the pool (started through run_task_async, so start() never blocks)
+// * stdexec::bulk on senders which complete on the scheduler is customized to run the iterations with pchunk and
+//   the run_opts and chunk_opts of the scheduler on the thread which completes the predecessor, with workers of the
+//   pool helping, so bulk work which follows other senders (async io) doesn't need a hop to the pool first
+//   on workers (as after schedule()) schedule_static is treated as schedule_dynamic, as it can't be nested
+//
+// exceptions thrown by bulk functions are sent to set_error, like in stdexec, also when they are thrown on workers
+// (the first one is sent and the chunks which haven't started yet are skipped)
+
+namespace par {
+
+class scheduler;
+
+namespace impl::exec {
+
+template <typename Receiver>
+struct schedule_op {
+    thread_pool& pool;
+    run_opts opts;
+    Receiver rcvr;
+
+    schedule_op(thread_pool& p, run_opts o, Receiver&& r)
+        : pool(p)
+        , opts(o)
+        , rcvr(std::move(r))
+    {}
+    schedule_op(const schedule_op&) = delete;
+    schedule_op& operator=(const schedule_op&) = delete;
+
+    void start() & noexcept {
+        run_opts aopts;
+        aopts.max_par = 1;
+        aopts.priority = opts.priority;
+        pool.run_task_async(aopts, [this](uint32_t) {
+            if (stdexec::get_stop_token(stdexec::get_env(rcvr)).stop_requested()) {
+                stdexec::set_stopped(std::move(rcvr));
+            }
+            else {
+                stdexec::set_value(std::move(rcvr));
+            }
+        }, []() {});
+    }
+};
+
+template <typename Sched>
+struct schedule_env {
+    Sched sched;
+
+    template <typename CPO>
+    Sched query(stdexec::get_completion_scheduler_t<CPO>) const noexcept {
+        return sched;
+    }
+};
+
+template <typename Sched>
+struct schedule_sender {
+    using sender_concept = stdexec::sender_t;
+    using completion_signatures = stdexec::completion_signatures<stdexec::set_value_t(), stdexec::set_stopped_t()>;
+
+    Sched sched;
+
+    schedule_env<Sched> get_env() const noexcept {
+        return {sched};
+    }
+
+    template <stdexec::receiver Receiver>
+    schedule_op<Receiver> connect(Receiver rcvr) const {
+        return schedule_op<Receiver>(sched.pool(), sched.opts(), std::move(rcvr));
+    }
+};
+
+template <typename Child, typename Shape, typename Fun, typename Receiver>
+struct bulk_op {
+    struct child_receiver {
+        using receiver_concept = stdexec::receiver_t;
+        bulk_op* op;
+
+        template <typename... Vs>
+        void set_value(Vs&&... vs) && noexcept {
+            op->run(std::forward<Vs>(vs)...);
+        }
+
+        template <typename E>
+        void set_error(E&& e) && noexcept {
+            stdexec::set_error(std::move(op->rcvr), std::forward<E>(e));
+        }
+
+        void set_stopped() && noexcept {
+            stdexec::set_stopped(std::move(op->rcvr));
+        }
+
+        decltype(auto) get_env() const noexcept {
+            return stdexec::get_env(op->rcvr);
+        }
+    };
+
+    thread_pool& pool;
+    run_opts opts;
+    chunk_opts copts;
+    Shape shape;
+    Fun fun;
+    Receiver rcvr;
+    stdexec::connect_result_t<Child, child_receiver> child_op;
+
+    template <typename Sched, typename C>
+    bulk_op(const Sched& sched, C&& child, Shape s, Fun&& f, Receiver&& r)
+        : pool(sched.pool())
+        , opts(sched.opts())
+        , copts(sched.chunking())
+        , shape(s)
+        , fun(std::move(f))
+        , rcvr(std::move(r))
+        , child_op(stdexec::connect(std::forward<C>(child), child_receiver{this}))
+    {}
+    bulk_op(const bulk_op&) = delete;
+    bulk_op& operator=(const bulk_op&) = delete;
+
+    void start() & noexcept {
+        stdexec::start(child_op);
+    }
+
+    template <typename... Vs>
+    void run(Vs&&... vs) noexcept {
+        // schedule() always completes on a worker, where a static region would be an invalid nested call
+        run_opts ropts = opts;
+        if (ropts.sched == schedule_static && pool.current_thread_is_worker()) {
+            ropts.sched = schedule_dynamic;
+        }
+
+        // exceptions must not escape the jobs on workers, keep the first one for set_error
+        std::atomic_flag failed = ATOMIC_FLAG_INIT;
+        std::exception_ptr error;
+        try {
+            pchunk(pool, ropts, copts, shape, [&](Shape begin, Shape end) {
+                if (failed.test(std::memory_order_relaxed)) return;
+                try {
+                    for (Shape i = begin; i < end; ++i) {
+                        fun(i, vs...);
+                    }
+                }
+                catch (...) {
+                    if (!failed.test_and_set(std::memory_order_relaxed)) {
+                        error = std::current_exception();
+                    }
+                }
+            });
+        }
+        catch (...) {
+            // invalid nested call
+            error = std::current_exception();
+        }
+        if (error) {
+            stdexec::set_error(std::move(rcvr), std::move(error));
+            return;
+        }
+        stdexec::set_value(std::move(rcvr), std::forward<Vs>(vs)...);
+    }
+};
+
+template <typename Sched, typename Child, typename Shape, typename Fun>
+struct bulk_sender {
+    using sender_concept = stdexec::sender_t;
+
+    Sched sched;
+    Child child;
+    Shape shape;
+    Fun fun;
+
+    template <typename Env>
+    auto get_completion_signatures(Env&&) const -> stdexec::transform_completion_signatures_of<
+        Child, Env, stdexec::completion_signatures<stdexec::set_error_t(std::exception_ptr)>
+    > {
+        return {};
+    }
+
+    decltype(auto) get_env() const noexcept {
+        return stdexec::get_env(child);
+    }
+
+    template <stdexec::receiver Receiver>
+    bulk_op<Child, Shape, Fun, Receiver> connect(Receiver rcvr) && {
+        return bulk_op<Child, Shape, Fun, Receiver>(sched, std::move(child), shape, std::move(fun), std::move(rcvr));
+    }
+
+    template <stdexec::receiver Receiver>
+        requires std::copy_constructible<Child> && std::copy_constructible<Fun>
+    bulk_op<const Child&, Shape, Fun, Receiver> connect(Receiver rcvr) const& {
+        return bulk_op<const Child&, Shape, Fun, Receiver>(sched, child, shape, Fun(fun), std::move(rcvr));
+    }
+};
+
+// bulk senders whose predecessors complete on a par::scheduler are transformed to bulk_sender
+struct domain : stdexec::default_domain {
+    template <stdexec::sender_expr_for<stdexec::bulk_t> Sender>
+    auto transform_sender(Sender&& sndr) const {
+        auto sched = stdexec::get_completion_scheduler<stdexec::set_value_t>(stdexec::get_env(sndr));
+        return stdexec::__sexpr_apply(std::forward<Sender>(sndr), [&]<typename Data, typename Child>(
+            stdexec::__ignore, Data&& data, Child&& child
+        ) {
+            auto [shape, fun] = std::forward<Data>(data);
+            using sender = bulk_sender<decltype(sched), std::decay_t<Child>, decltype(shape), decltype(fun)>;
+            return sender{sched, std::forward<Child>(child), shape, std::move(fun)};
+        });
+    }
+};
+
+} // namespace impl::exec
+
+class scheduler {
+public:
+    explicit scheduler(thread_pool& pool, run_opts opts = {}, chunk_opts copts = {})
+        : m_pool(&pool)
+        , m_opts(opts)
+        , m_copts(copts)
+    {}
+    scheduler() : scheduler(thread_pool::global()) {}
+
+    thread_pool& pool() const noexcept { return *m_pool; }
+
+    // used by bulk, schedule() only uses the priority
+    const run_opts& opts() const noexcept { return m_opts; }
+    const chunk_opts& chunking() const noexcept { return m_copts; }
+
+    impl::exec::schedule_sender<scheduler> schedule() const noexcept {
+        return {*this};
+    }
+
+    // schedulers of the same pool run work on the same threads
+    bool operator==(const scheduler& other) const noexcept {
+        return m_pool == other.m_pool;
+    }
+
+    stdexec::forward_progress_guarantee query(stdexec::get_forward_progress_guarantee_t) const noexcept {
+        return stdexec::forward_progress_guarantee::parallel;
+    }
+
+    impl::exec::domain query(stdexec::get_domain_t) const noexcept {
+        return {};
+    }
+
+private:
+    thread_pool* m_pool;
+    run_opts m_opts;
+    chunk_opts m_copts;
+};
+
+} // namespace par
@@ -0,0 +1,45 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "api.h"
+#include <memory>
+#include <cstdint>
+
+namespace par {
+
+class thread_pool;
+
+// a group of thread pools which lend idle workers to each other
+// an idle worker of a member pool executes pending dynamic jobs of other members
+// while it does, it counts as a worker of both pools, so the nesting rules hold for both
+// (current_thread_is_worker() is true for both and static calls on either throw)
+// only dynamic jobs which have been queued are lent, static jobs and jobs given directly to workers are not
+// the federation must outlive its member pools
+// a pool leaves the federation when it's destroyed
+class PAR_API federation {
+public:
+    struct member_opts {
+        // max number of workers of this pool which may run jobs of other pools at the same time
+        uint32_t max_lent_workers = UINT32_MAX;
+
+        // max number of jobs of this pool which may run on workers of other pools at the same time
+        uint32_t max_borrowed_jobs = UINT32_MAX;
+    };
+
+    federation();
+    ~federation();
+
+    federation(const federation&) = delete;
+    federation& operator=(const federation&) = delete;
+
+    // throw if the pool is already a member of a federation
+    void add(thread_pool& pool, const member_opts& opts);
+    void add(thread_pool& pool);
+
+    struct impl;
+private:
+    std::unique_ptr<impl> m_impl;
+};
+
+} // namespace par
@@ -2,11 +2,16 @@
 // SPDX-License-Identifier: MIT
 //
 #pragma once
+#include "scratch_arena.hpp"
 #include <cstdint>
 
 namespace par {
 struct job_info {
     uint32_t job_index;
     uint32_t num_jobs;
+
+    // temporary memory of the thread running the job
+    // allocations are released when the job ends
+    scratch_arena& scratch() const { return scratch_arena::current(); }
 };
 } // namespace par
@@ -4,7 +4,12 @@
 #pragma once
 #include "thread_pool.hpp"
 #include "job_info.hpp"
+#include "cancellation_token.hpp"
+#include "bits/imath.hpp"
 #include <splat/inline.h>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
 #include <type_traits>
 
 namespace par {
@@ -21,30 +26,104 @@ FORCE_INLINE void invoke_pchunk_func(I begin, I end, [[maybe_unused]] const job_
 }
 } // namespace impl
 
+struct chunk_opts {
+    // number of chunks per job
+    // with more than one, dynamically scheduled jobs claim chunks as they finish previous ones, so that a slow chunk
+    // doesn't hold up the others, and statically scheduled jobs get every num_jobs-th chunk
+    uint32_t chunks_per_job = 1;
+
+    // chunks are not made smaller than this, which may reduce the number of chunks and jobs
+    uint32_t min_chunk_size = 1;
+};
+
+// call func(begin, end) or func(begin, end, job_info) for contiguous chunks which cover [0, size)
+// the job info identifies the job which runs the chunk
+// with opts.cancel, no more chunks are started once it's cancelled
+// return the number of chunks
 template <typename I, typename Func>
-uint32_t pchunk(thread_pool& pool, run_opts opts, const I size, Func&& func) {
+uint32_t pchunk(thread_pool& pool, run_opts opts, const chunk_opts& copts, const I size, Func&& func) {
     if (size == 0) return 0; // nothing to do
-    const auto num_chunks = pool.adjust_par(size, opts);
+    using U = std::make_unsigned_t<I>;
+    const U usize = U(size);
+
+    U num_jobs = U(pool.adjust_par(size, opts));
+    if (num_jobs == 0) {
+        throw std::runtime_error("unsupported nested par call");
+    }
 
-    if (num_chunks == 1) {
-        // only one chunk, just call the function and skip the overhead below
-        impl::invoke_pchunk_func(I(0), size, job_info{0, 1}, func);
-        return 1;
+    const U max_chunks = std::max(U(1), usize / std::max(U(1), U(copts.min_chunk_size)));
+    U num_chunks = std::min(num_jobs * std::max(U(1), U(copts.chunks_per_job)), max_chunks);
+    const U chunk_size = divide_round_up(usize, num_chunks);
+    num_chunks = divide_round_up(usize, chunk_size); // rounding up the size may leave fewer chunks
+    if (num_jobs > num_chunks) {
+        num_jobs = num_chunks;
+        opts.max_par = uint32_t(num_jobs);
     }
 
-    const auto chunk_size = (size + num_chunks - 1) / num_chunks;
-    auto wfunc = [&](uint32_t ci) {
+    auto run_chunk = [&](U ci, const job_info& ji) {
         const auto begin = I(ci * chunk_size);
-        const auto end = I(ci + 1) < num_chunks ? begin + chunk_size : size;
-        job_info ji{ci, uint32_t(num_chunks)};
+        const auto end = ci + 1 < num_chunks ? I(begin + chunk_size) : size;
         impl::invoke_pchunk_func(begin, end, ji, func);
     };
-    return pool.run_task(opts, thread_pool::task_func(wfunc));
+
+    if (num_jobs == 1) {
+        // only one job, just call the function and skip the overhead below
+        scratch_arena::scope scratch;
+        const job_info ji{0, 1};
+        for (U ci = 0; ci < num_chunks; ++ci) {
+            if (impl::is_cancelled(opts.cancel)) break;
+            run_chunk(ci, ji);
+        }
+        return uint32_t(num_chunks);
+    }
+
+    if (num_chunks == num_jobs) {
+        auto wfunc = [&](uint32_t ji) {
+            if (impl::is_cancelled(opts.cancel)) return;
+            run_chunk(ji, job_info{ji, uint32_t(num_jobs)});
+        };
+        pool.run_task(opts, thread_pool::task_func(wfunc));
+    }
+    else if (opts.sched == schedule_static) {
+        auto wfunc = [&](uint32_t ji) {
+            const job_info info{ji, uint32_t(num_jobs)};
+            for (U ci = ji; ci < num_chunks; ci += num_jobs) {
+                if (impl::is_cancelled(opts.cancel)) return;
+                run_chunk(ci, info);
+            }
+        };
+        pool.run_task(opts, thread_pool::task_func(wfunc));
+    }
+    else {
+        std::atomic<U> next = 0;
+        auto wfunc = [&](uint32_t ji) {
+            const job_info info{ji, uint32_t(num_jobs)};
+            while (true) {
+                if (impl::is_cancelled(opts.cancel)) return;
+                const U ci = next.fetch_add(1, std::memory_order_relaxed);
+                if (ci >= num_chunks) return; // all done
+                run_chunk(ci, info);
+            }
+        };
+        pool.run_task(opts, thread_pool::task_func(wfunc));
+    }
+
+    return uint32_t(num_chunks);
+}
+
+template <typename I, typename Func>
+uint32_t pchunk(thread_pool& pool, run_opts opts, const I size, Func&& func) {
+    return pchunk(pool, opts, chunk_opts{}, size, std::forward<Func>(func));
+}
+
+template <typename I, typename Func>
+uint32_t pchunk(run_opts opts, const chunk_opts& copts, const I size, Func&& func) {
+    return pchunk(thread_pool::global(), opts, copts, size, std::forward<Func>(func));
 }
 
 template <typename I, typename Func>
 uint32_t pchunk(run_opts opts, const I size, Func&& func) {
-    return pchunk(thread_pool::global(), opts, size, std::forward<Func>(func));
+    return pchunk(thread_pool::global(), opts, chunk_opts{}, size, std::forward<Func>(func));
 }
 
 } // namespace par
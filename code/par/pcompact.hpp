@@ -0,0 +1,247 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "pfor.hpp"
+#include "bits/imath.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// parallel stream compaction: pcopy_if, premove_if, ppartition
+// all of them are stable (the relative order of the elements is preserved)
+//
+// the predicate is evaluated once per element in a first pass, which stores the results in a bit mask and counts
+// the matches of each chunk
+// an exclusive scan of the counts gives the output offset of each chunk, so in the second pass each chunk writes
+// its own part of the output without atomics
+// opts.cancel is ignored, as a partial compaction would leave the output in an unusable state
+
+namespace par {
+
+namespace impl {
+
+class compaction {
+public:
+    // chunks are multiples of 64 elements, so that each one has its own words of the mask
+    // several chunks per job for balancing, but not too small, as they are claimed dynamically
+    compaction(thread_pool& pool, run_opts& opts, size_t size)
+        : m_size(size)
+    {
+        opts.cancel = nullptr;
+        const size_t num_jobs = std::max(size_t(1), pool.get_par(size, opts));
+        m_chunk_size = std::max(size_t(4096), divide_round_up(size, num_jobs * 4));
+        m_chunk_size = divide_round_up(m_chunk_size, size_t(64)) * 64;
+        m_num_chunks = divide_round_up(size, m_chunk_size);
+        m_mask = std::make_unique_for_overwrite<uint64_t[]>(divide_round_up(size, size_t(64)));
+        m_offsets.resize(m_num_chunks);
+    }
+
+    size_t size() const { return m_size; }
+    size_t num_matches() const { return m_num_matches; }
+
+    // first pass
+    template <typename Match>
+    void classify(thread_pool& pool, const run_opts& opts, Match& match) {
+        pfor(pool, opts, size_t(0), m_num_chunks, [&](size_t c) {
+            const auto [cbegin, cend] = chunk(c);
+            size_t count = 0;
+            for (size_t base = cbegin; base < cend; base += 64) {
+                const size_t n = std::min(size_t(64), cend - base);
+                uint64_t bits = 0;
+                for (size_t b = 0; b < n; ++b) {
+                    bits |= uint64_t(!!match(base + b)) << b;
+                }
+                m_mask[base / 64] = bits;
+                count += size_t(std::popcount(bits));
+            }
+            m_offsets[c] = count;
+        });
+
+        // the number of chunks is small, so the scan is not worth a parallel region
+        size_t sum = 0;
+        for (auto& o : m_offsets) {
+            const auto count = o;
+            o = sum;
+            sum += count;
+        }
+        m_num_matches = sum;
+    }
+
+    // second pass, call f(index, output_index) for the matching elements
+    template <typename F>
+    void scatter_matches(thread_pool& pool, const run_opts& opts, F&& f) {
+        pfor(pool, opts, size_t(0), m_num_chunks, [&](size_t c) {
+            const auto [cbegin, cend] = chunk(c);
+            size_t out = m_offsets[c];
+            for (size_t base = cbegin; base < cend; base += 64) {
+                for (uint64_t bits = m_mask[base / 64]; bits; bits &= bits - 1) {
+                    f(base + size_t(std::countr_zero(bits)), out++);
+                }
+            }
+        });
+    }
+
+    // second pass, call f(index, output_index) for all elements
+    // matching elements go to [0, num_matches()), the others to [num_matches(), size())
+    template <typename F>
+    void scatter_all(thread_pool& pool, const run_opts& opts, F&& f) {
+        pfor(pool, opts, size_t(0), m_num_chunks, [&](size_t c) {
+            const auto [cbegin, cend] = chunk(c);
+            size_t matched = m_offsets[c]; // matches before the current element
+            for (size_t base = cbegin; base < cend; base += 64) {
+                const size_t n = std::min(size_t(64), cend - base);
+                const uint64_t bits = m_mask[base / 64];
+                for (size_t b = 0; b < n; ++b) {
+                    const size_t i = base + b;
+                    if (bits & (uint64_t(1) << b)) {
+                        f(i, matched++);
+                    }
+                    else {
+                        f(i, m_num_matches + i - matched);
+                    }
+                }
+            }
+        });
+    }
+
+private:
+    std::pair<size_t, size_t> chunk(size_t c) const {
+        const size_t cbegin = c * m_chunk_size;
+        return {cbegin, std::min(cbegin + m_chunk_size, m_size)};
+    }
+
+    size_t m_size;
+    size_t m_chunk_size;
+    size_t m_num_chunks;
+    std::unique_ptr<uint64_t[]> m_mask;
+    std::vector<size_t> m_offsets; // counts of matches per chunk before the scan
+    size_t m_num_matches = 0;
+};
+
+// raw storage for the elements moved out by the in-place algorithms
+template <typename T>
+class relocation_buffer {
+public:
+    explicit relocation_buffer(size_t size)
+        : m_size(size)
+        , m_data(std::allocator<T>{}.allocate(size))
+    {}
+
+    relocation_buffer(const relocation_buffer&) = delete;
+    relocation_buffer& operator=(const relocation_buffer&) = delete;
+
+    // the elements must have been destroyed
+    ~relocation_buffer() {
+        std::allocator<T>{}.deallocate(m_data, m_size);
+    }
+
+    T* data() { return m_data; }
+
+private:
+    size_t m_size;
+    T* m_data;
+};
+
+// move the elements of the buffer back to the range and destroy them
+template <typename T, typename It>
+void move_back(thread_pool& pool, const run_opts& opts, relocation_buffer<T>& buf, It first, size_t size) {
+    T* data = buf.data();
+    pfor(pool, opts, range(size).job_chunk(size_t(4096)), [&](size_t i) {
+        first[i] = std::move(data[i]);
+        std::destroy_at(data + i);
+    });
+}
+
+// the elements are relocated through a buffer, which can't be unwound if moving them throws
+template <typename It>
+concept nothrow_relocatable_iterator =
+    std::is_nothrow_move_constructible_v<std::iter_value_t<It>>
+    && std::is_nothrow_move_assignable_v<std::iter_value_t<It>>;
+
+} // namespace impl
+
+// copy the elements of [first, last) for which pred is true to out
+// return the end of the output
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, typename Pred>
+OutIt pcopy_if(thread_pool& pool, run_opts opts, InIt first, InIt last, OutIt out, Pred&& pred) {
+    if (first >= last) return out;
+    const size_t size = size_t(last - first);
+    impl::compaction c(pool, opts, size);
+    auto match = [&](size_t i) { return pred(first[i]); };
+    c.classify(pool, opts, match);
+    c.scatter_matches(pool, opts, [&](size_t i, size_t o) {
+        out[o] = first[i];
+    });
+    return out + c.num_matches();
+}
+
+template <std::random_access_iterator InIt, std::random_access_iterator OutIt, typename Pred>
+OutIt pcopy_if(run_opts opts, InIt first, InIt last, OutIt out, Pred&& pred) {
+    return pcopy_if(thread_pool::global(), opts, first, last, out, std::forward<Pred>(pred));
+}
+
+// remove the elements of [first, last) for which pred is true
+// return the new end of the range, the elements after it are moved-from
+// the elements must be nothrow move constructible and assignable
+template <std::random_access_iterator It, typename Pred>
+    requires impl::nothrow_relocatable_iterator<It>
+It premove_if(thread_pool& pool, run_opts opts, It first, It last, Pred&& pred) {
+    if (first >= last) return last;
+    using T = std::iter_value_t<It>;
+    const size_t size = size_t(last - first);
+    impl::compaction c(pool, opts, size);
+    auto keep = [&](size_t i) { return !pred(first[i]); };
+    c.classify(pool, opts, keep);
+    if (c.num_matches() == size) return last; // nothing to remove
+
+    // kept elements may be moved to positions which other jobs have yet to read, so they go through a buffer
+    impl::relocation_buffer<T> buf(c.num_matches());
+    T* data = buf.data();
+    c.scatter_matches(pool, opts, [&](size_t i, size_t o) {
+        std::construct_at(data + o, std::move(first[i]));
+    });
+    impl::move_back(pool, opts, buf, first, c.num_matches());
+    return first + c.num_matches();
+}
+
+template <std::random_access_iterator It, typename Pred>
+    requires impl::nothrow_relocatable_iterator<It>
+It premove_if(run_opts opts, It first, It last, Pred&& pred) {
+    return premove_if(thread_pool::global(), opts, first, last, std::forward<Pred>(pred));
+}
+
+// stable partition of [first, last): the elements for which pred is true come first
+// return the first element of the second group
+// the elements must be nothrow move constructible and assignable
+template <std::random_access_iterator It, typename Pred>
+    requires impl::nothrow_relocatable_iterator<It>
+It ppartition(thread_pool& pool, run_opts opts, It first, It last, Pred&& pred) {
+    if (first >= last) return last;
+    using T = std::iter_value_t<It>;
+    const size_t size = size_t(last - first);
+    impl::compaction c(pool, opts, size);
+    auto match = [&](size_t i) { return pred(first[i]); };
+    c.classify(pool, opts, match);
+    if (c.num_matches() == 0 || c.num_matches() == size) return first + c.num_matches();
+
+    impl::relocation_buffer<T> buf(size);
+    T* data = buf.data();
+    c.scatter_all(pool, opts, [&](size_t i, size_t o) {
+        std::construct_at(data + o, std::move(first[i]));
+    });
+    impl::move_back(pool, opts, buf, first, size);
+    return first + c.num_matches();
+}
+
+template <std::random_access_iterator It, typename Pred>
+    requires impl::nothrow_relocatable_iterator<It>
+It ppartition(run_opts opts, It first, It last, Pred&& pred) {
+    return ppartition(thread_pool::global(), opts, first, last, std::forward<Pred>(pred));
+}
+
+} // namespace par
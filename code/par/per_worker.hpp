@@ -0,0 +1,173 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "thread_pool.hpp"
+#include "bits/cpu.hpp"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+
+#include <splat/warnings.h>
+PRAGMA_WARNING_PUSH
+DISABLE_MSVC_WARNING(4324)
+
+namespace par {
+
+// persistent per-thread state of the jobs of a thread pool
+// the equivalent of tbb::enumerable_thread_specific
+// unlike job data (see pfor) it outlives regions, so expensive state (rngs, buffers) is constructed only once
+// there is one slot per worker and one for the caller thread, each constructed lazily on first access
+// other threads which run jobs of the pool get slots, too, but accessing them is slower:
+// * callers of concurrent regions besides the first one to access the container
+// * workers of other pools in a federation
+// threads which aren't workers of the pool hold their slot until the region they run ends (see
+// thread_pool::at_region_end), then other threads can take it over with its value, so the number of slots is bounded
+// by the threads which access the container concurrently
+// (accesses outside of regions hold the slot for the lifetime of the container)
+// the container must outlive the regions which access it
+template <typename T>
+class per_worker {
+public:
+    // init: T() or T(uint32_t slot_index)
+    // slot indices are unique, workers get [0, pool.max_threads()), the caller slot gets pool.max_threads()
+    template <typename InitFunc>
+    per_worker(thread_pool& pool, InitFunc init)
+        : m_pool(pool)
+        , m_num_worker_slots(pool.max_threads())
+        , m_slots(std::make_unique<slot[]>(m_num_worker_slots + 1))
+    {
+        if constexpr (std::is_invocable_v<InitFunc, uint32_t>) {
+            m_init = std::move(init);
+        }
+        else {
+            m_init = [init = std::move(init)](uint32_t) { return init(); };
+        }
+    }
+
+    explicit per_worker(thread_pool& pool)
+        : per_worker(pool, [] { return T{}; })
+    {}
+
+    per_worker(const per_worker&) = delete;
+    per_worker& operator=(const per_worker&) = delete;
+
+    // the slot of the current thread
+    T& local() {
+        if (auto wi = m_pool.current_worker_index()) {
+            return get(m_slots[*wi], *wi);
+        }
+        return non_worker_local();
+    }
+
+    // iterate over all constructed slots
+    // not safe while jobs of the pool access the container
+    template <typename Func>
+    void for_each(Func&& func) {
+        for (uint32_t i = 0; i <= m_num_worker_slots; ++i) {
+            if (m_slots[i].value) func(*m_slots[i].value);
+        }
+        for (auto& os : m_other_slots) {
+            func(*os.s.value);
+        }
+    }
+
+    // combine all constructed slots into init with op(R, const T&)
+    template <typename R, typename Op>
+    R combine(R init, Op&& op) {
+        for_each([&](T& v) {
+            init = op(std::move(init), v);
+        });
+        return init;
+    }
+
+    // destroy all slots, they will be constructed again on the next access
+    // not safe while jobs of the pool access the container
+    void clear() {
+        for (uint32_t i = 0; i <= m_num_worker_slots; ++i) {
+            m_slots[i].value.reset();
+        }
+        m_caller_id.store(std::thread::id{}, std::memory_order_relaxed);
+        m_other_slots.clear();
+    }
+
+private:
+    struct alignas(cpu::alignment_to_avoid_false_sharing) slot {
+        std::optional<T> value;
+    };
+
+    T& get(slot& s, uint32_t index) {
+        if (!s.value) {
+            s.value.emplace(m_init(index));
+        }
+        return *s.value;
+    }
+
+    T& non_worker_local() {
+        const auto id = std::this_thread::get_id();
+
+        // the first thread to get here owns the caller slot until its region ends
+        auto caller = m_caller_id.load(std::memory_order_acquire);
+        if (caller == std::thread::id{}
+            && m_caller_id.compare_exchange_strong(caller, id, std::memory_order_acq_rel)
+        ) {
+            caller = id;
+            thread_pool::at_region_end([this]() {
+                m_caller_id.store(std::thread::id{}, std::memory_order_release);
+            });
+        }
+        if (caller == id) {
+            return get(m_slots[m_num_worker_slots], m_num_worker_slots);
+        }
+
+        std::lock_guard lock(m_other_slots_mutex);
+        other_slot* free = nullptr;
+        for (auto& os : m_other_slots) {
+            if (os.id == id) return *os.s.value;
+            if (!free && os.id == std::thread::id{}) free = &os;
+        }
+        if (!free) {
+            free = &m_other_slots.emplace_back(m_num_worker_slots + 1 + uint32_t(m_other_slots.size()));
+            try {
+                get(free->s, free->index);
+            }
+            catch (...) {
+                // don't leave an empty slot behind
+                m_other_slots.pop_back();
+                throw;
+            }
+        }
+        free->id = id;
+        thread_pool::at_region_end([this, i = free->index - m_num_worker_slots - 1]() {
+            std::lock_guard l(m_other_slots_mutex);
+            if (i < m_other_slots.size()) m_other_slots[i].id = std::thread::id{};
+        });
+        return *free->s.value;
+    }
+
+    thread_pool& m_pool;
+    std::function<T(uint32_t)> m_init;
+
+    const uint32_t m_num_worker_slots;
+    std::unique_ptr<slot[]> m_slots; // workers, then caller
+
+    std::atomic<std::thread::id> m_caller_id;
+
+    struct other_slot {
+        explicit other_slot(uint32_t i) : index(i) {}
+        uint32_t index;
+        std::thread::id id; // the thread which holds it, if any
+        slot s;
+    };
+    std::mutex m_other_slots_mutex;
+    std::deque<other_slot> m_other_slots; // a deque, so that references are stable
+};
+
+} // namespace par
+
+PRAGMA_WARNING_POP
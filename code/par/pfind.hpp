@@ -0,0 +1,89 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "pfor.hpp"
+#include "cancellation_token.hpp"
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
+// parallel searches which stop early
+// the result is deterministic: the lowest matching index, regardless of the number of jobs and their timing
+
+namespace par {
+
+namespace impl {
+
+// chunks of iterations are claimed in increasing order
+// so when a match is found, all lower indices have already been claimed and are evaluated
+// the chunks are small enough for the search to stop soon after a match and large enough to amortize the claims
+template <typename U>
+U search_chunk_size(U size, U num_jobs) {
+    constexpr U chunks_per_job = 64;
+    return std::max(U(1), size / (num_jobs * chunks_per_job));
+}
+
+template <typename U>
+void atomic_min(std::atomic<U>& a, U value) {
+    U cur = a.load(std::memory_order_relaxed);
+    while (value < cur && !a.compare_exchange_weak(cur, value, std::memory_order_relaxed));
+}
+
+} // namespace impl
+
+// return the lowest index in [begin, end) for which pred(index) is true or end if there is none
+// searches are always dynamically scheduled, opts.sched and opts.affinity are ignored
+// opts.cancel is ignored, searches use their own token
+template <typename I, typename Pred>
+I pfind_if(thread_pool& pool, run_opts opts, const I begin, const I end, Pred&& pred) {
+    if (begin >= end) return end;
+    using U = std::make_unsigned_t<I>;
+    const U size = U(end) - U(begin);
+
+    // chunks are claimed in order, so that the jobs stop soon after the lowest match
+    opts.sched = schedule_dynamic;
+    opts.affinity = nullptr;
+    const U num_jobs = pool.get_par(size, opts);
+
+    std::atomic<U> found = size;
+    cancellation_token token;
+    opts.cancel = &token;
+
+    pfor(pool, opts, range(U(0), size).job_chunk(impl::search_chunk_size(size, num_jobs)), [&](U i) {
+        if (i >= found.load(std::memory_order_relaxed)) return; // a lower match has been found
+        if (pred(I(U(begin) + i))) {
+            impl::atomic_min(found, i);
+            token.cancel();
+        }
+    });
+
+    return I(U(begin) + found.load(std::memory_order_relaxed));
+}
+
+template <typename I, typename Pred>
+I pfind_if(run_opts opts, const I begin, const I end, Pred&& pred) {
+    return pfind_if(thread_pool::global(), opts, begin, end, std::forward<Pred>(pred));
+}
+
+template <typename I, typename Pred>
+bool pany_of(thread_pool& pool, run_opts opts, const I begin, const I end, Pred&& pred) {
+    return pfind_if(pool, opts, begin, end, std::forward<Pred>(pred)) != end;
+}
+
+template <typename I, typename Pred>
+bool pany_of(run_opts opts, const I begin, const I end, Pred&& pred) {
+    return pany_of(thread_pool::global(), opts, begin, end, std::forward<Pred>(pred));
+}
+
+template <typename I, typename Pred>
+bool pall_of(thread_pool& pool, run_opts opts, const I begin, const I end, Pred&& pred) {
+    return pfind_if(pool, opts, begin, end, [&](I i) { return !pred(i); }) == end;
+}
+
+template <typename I, typename Pred>
+bool pall_of(run_opts opts, const I begin, const I end, Pred&& pred) {
+    return pall_of(thread_pool::global(), opts, begin, end, std::forward<Pred>(pred));
+}
+
+} // namespace par
@@ -4,6 +4,8 @@
 #pragma once
 #include "thread_pool.hpp"
 #include "job_info.hpp"
+#include "cancellation_token.hpp"
+#include "affinity_partitioner.hpp"
 #include "bits/imath.hpp"
 #include <splat/inline.h>
 #include <atomic>
@@ -80,11 +82,14 @@ void simple_pfor(
     const U size = U(end) - U(begin);
 
     const auto num_jobs = pool.adjust_par(size, opts);
+    const cancellation_token* const cancel = opts.cancel;
 
     if (num_jobs == 1) {
         // only one worker, just call the function and skip the overhead below
+        scratch_arena::scope scratch;
         JobData data = init_job_data(job_info{0, 1});
         for (I i = begin; i < end; ++i) {
+            if (is_cancelled(cancel)) return;
             invoke_pfor_func(i, data, func);
         }
         return;
@@ -98,18 +103,46 @@ void simple_pfor(
             const auto wbegin = U(ji * worker_part);
             const auto wend = U(ji + 1) < num_jobs ? wbegin + worker_part : size;
             for (U i = wbegin; i < wend; ++i) {
+                if (is_cancelled(cancel)) return;
                 invoke_pfor_func(I(U(begin) + i), data, func);
             }
         };
 
         pool.run_task(opts, thread_pool::task_func(wfunc));
     }
+    else if (opts.sched == schedule_affinity && opts.affinity) {
+        auto& affinity = *opts.affinity;
+        affinity.begin_loop(pool, size, uint32_t(num_jobs));
+        const bool may_yield = opts.priority == priority_background;
+
+        auto wfunc = [&](uint32_t ji) {
+            JobData data = init_job_data(job_info{ji, uint32_t(num_jobs)});
+            const bool yielding = may_yield && ji != 0;
+            affinity.run_blocks(pool, [&](uint64_t bbegin, uint64_t bend) {
+                if (yielding && pool.have_higher_priority_work(priority_background)) return false;
+                for (U i = U(bbegin); i < U(bend); ++i) {
+                    if (is_cancelled(cancel)) return false;
+                    invoke_pfor_func(I(U(begin) + i), data, func);
+                }
+                return true;
+            });
+        };
+
+        pool.run_task(opts, thread_pool::task_func(wfunc));
+    }
     else {
         std::atomic<U> slot = 0;
 
+        // background jobs on workers yield to higher priority work
+        // the caller thread (job 0) never yields, so it finishes the loop if all others do
+        const bool may_yield = opts.priority == priority_background;
+
         auto wfunc = [&](uint32_t ji) {
             JobData data = init_job_data(job_info{ji, uint32_t(num_jobs)});
+            const bool yielding = may_yield && ji != 0;
             while (true) {
+                if (yielding && pool.have_higher_priority_work(priority_background)) return;
+                if (is_cancelled(cancel)) return;
                 const U i = slot.fetch_add(1, std::memory_order_relaxed);
                 if (i >= size) return; // all done
                 invoke_pfor_func(I(U(begin) + i), data, func);
@@ -152,7 +185,7 @@ void range_pfor(
         return range.end >= range.begin ? end - begin : begin - end;
     }();
 
-    const U total_iterations = divide_round_up(range_size, U(std::abs(range.step)));
+    const U total_iterations = divide_round_up(range_size, unsigned_abs(range.step));
     const U num_chunks = divide_round_up(total_iterations, U(range.iterations_per_job));
     const U chunk_size = U(range.iterations_per_job);
 
@@ -160,9 +193,11 @@ void range_pfor(
 
     if (num_jobs == 1) {
         // only one worker, just call the function and skip the overhead below
+        scratch_arena::scope scratch;
         JobData data = init_job_data(job_info{0, 1});
         I i = range.begin;
         for (U u = 0; u < total_iterations; ++u, i += range.step) {
+            if (is_cancelled(opts.cancel)) return;
             invoke_pfor_func(i, data, func);
         }
         return;
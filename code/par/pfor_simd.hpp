@@ -0,0 +1,170 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "pfor.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+// parallel for loops whose body is called with blocks of W consecutive indices
+// the body can then process the block with a fixed-width inner loop (or intrinsics), which compilers vectorize
+// unlike pfor, where the body is called with a single index at a time
+
+namespace par {
+
+// W consecutive indices, first is a multiple of W
+template <size_t W, typename I>
+struct simd_block {
+    I first;
+
+    static constexpr size_t width = W;
+
+    I operator[](size_t lane) const {
+        return I(first + I(lane));
+    }
+};
+
+namespace impl {
+
+// offset of value from the previous multiple of a
+template <typename I>
+constexpr std::make_unsigned_t<I> align_offset(I value, I a) {
+    I r = I(value % a);
+    if constexpr (std::is_signed_v<I>) {
+        if (r < 0) r += a;
+    }
+    return std::make_unsigned_t<I>(r);
+}
+
+template <size_t W, size_t ChunkAlign, typename JobData, typename I, typename JobDataInitFunc, typename BlockFunc, typename ScalarFunc>
+void simd_pfor(
+    thread_pool& pool,
+    run_opts opts,
+    JobDataInitFunc&& init_job_data,
+    const I begin, const I end,
+    BlockFunc&& block_func,
+    ScalarFunc&& scalar_func
+) {
+    static_assert(W > 0, "simd width must be positive");
+    static_assert(ChunkAlign % W == 0, "chunk alignment must be a multiple of the simd width");
+
+    if (begin >= end) return; // nothing to do
+    using U = std::make_unsigned_t<I>;
+    using block = simd_block<W, I>;
+    constexpr U w = U(W);
+    constexpr U ca = U(ChunkAlign);
+    const U size = U(end) - U(begin);
+    const cancellation_token* const cancel = opts.cancel;
+
+    // blocks start at multiples of W, so that they map to aligned addresses of aligned arrays
+    // the indices before the first block and after the last one are scalar
+    const U head = std::min(size, (w - align_offset(begin, I(W))) % w);
+    const U num_blocks = (size - head) / w;
+    const I body_begin = I(U(begin) + head);
+    const I body_end = I(U(body_begin) + num_blocks * w);
+
+    auto run_scalars = [&](I sbegin, I send, JobData& data) {
+        for (I i = sbegin; i < send; ++i) {
+            if (is_cancelled(cancel)) return;
+            invoke_pfor_func(i, data, scalar_func);
+        }
+    };
+
+    // positions of the body on a grid of chunks, whose boundaries are multiples of ChunkAlign
+    // the first and last chunks may be partial
+    const U grid_offset = align_offset(body_begin, I(ChunkAlign));
+    const U grid_size = grid_offset + num_blocks * w;
+    const U grid_base = U(body_begin) - grid_offset;
+
+    // dynamic scheduling claims a chunk of ChunkAlign indices at a time
+    const U num_jobs = num_blocks ? pool.adjust_par(divide_round_up(grid_size, ca), opts) : 1;
+
+    if (num_jobs == 1) {
+        // only one worker, just call the functions and skip the overhead below
+        scratch_arena::scope scratch;
+        JobData data = init_job_data(job_info{0, 1});
+        run_scalars(begin, body_begin, data);
+        for (I i = body_begin; i < body_end; i = I(i + I(W))) {
+            if (is_cancelled(cancel)) return;
+            invoke_pfor_func(block{i}, data, block_func);
+        }
+        run_scalars(body_end, end, data);
+        return;
+    }
+
+    // static scheduling gives each job a single chunk
+    const U chunk_size = opts.sched == schedule_static
+        ? divide_round_up(divide_round_up(grid_size, num_jobs), ca) * ca
+        : ca;
+    const U num_chunks = divide_round_up(grid_size, chunk_size);
+
+    auto run_chunk = [&](U ci, JobData& data) {
+        const U cbegin = std::max(ci * chunk_size, grid_offset);
+        const U cend = std::min((ci + 1) * chunk_size, grid_size);
+        for (U p = cbegin; p < cend; p += w) {
+            if (is_cancelled(cancel)) return;
+            invoke_pfor_func(block{I(grid_base + p)}, data, block_func);
+        }
+    };
+
+    if (opts.sched == schedule_static) {
+        auto wfunc = [&](uint32_t ji) {
+            JobData data = init_job_data(job_info{ji, uint32_t(num_jobs)});
+            if (ji == 0) run_scalars(begin, body_begin, data);
+            if (ji < num_chunks) run_chunk(ji, data);
+            if (ji == 0) run_scalars(body_end, end, data);
+        };
+
+        pool.run_task(opts, thread_pool::task_func(wfunc));
+    }
+    else {
+        std::atomic<U> slot = 0;
+        const bool may_yield = opts.priority == priority_background;
+
+        auto wfunc = [&](uint32_t ji) {
+            JobData data = init_job_data(job_info{ji, uint32_t(num_jobs)});
+            const bool yielding = may_yield && ji != 0;
+            if (ji == 0) run_scalars(begin, body_begin, data);
+            while (true) {
+                if (yielding && pool.have_higher_priority_work(priority_background)) break;
+                if (is_cancelled(cancel)) break;
+                const U ci = slot.fetch_add(1, std::memory_order_relaxed);
+                if (ci >= num_chunks) break; // all done
+                run_chunk(ci, data);
+            }
+            if (ji == 0) run_scalars(body_end, end, data);
+        };
+
+        pool.run_task(opts, thread_pool::task_func(wfunc));
+    }
+}
+
+} // namespace impl
+
+// block_func(simd_block<W, I>) is called for the W-aligned blocks in [begin, end)
+// scalar_func(I) is called for the remaining indices at the start and at the end of the range
+// both can also take JobData& as a second argument like the body of pfor
+// ChunkAlign is the granularity of the ranges of blocks given to jobs, it must be a multiple of W
+// set it so that it spans a multiple of cpu::cache_line_size bytes of the output, to keep jobs from writing to the
+// same cache lines
+template <size_t W, size_t ChunkAlign = W, typename JobData = job_info, typename I, typename BlockFunc, typename ScalarFunc>
+void pfor_simd(thread_pool& pool, run_opts opts, const I begin, const I end, BlockFunc&& block_func, ScalarFunc&& scalar_func) {
+    impl::simd_pfor<W, ChunkAlign, JobData>(
+        pool, opts,
+        impl::default_job_data_init<JobData>,
+        begin, end,
+        std::forward<BlockFunc>(block_func), std::forward<ScalarFunc>(scalar_func)
+    );
+}
+
+template <size_t W, size_t ChunkAlign = W, typename JobData = job_info, typename I, typename BlockFunc, typename ScalarFunc>
+void pfor_simd(run_opts opts, const I begin, const I end, BlockFunc&& block_func, ScalarFunc&& scalar_func) {
+    pfor_simd<W, ChunkAlign, JobData>(
+        thread_pool::global(), opts, begin, end,
+        std::forward<BlockFunc>(block_func), std::forward<ScalarFunc>(scalar_func)
+    );
+}
+
+} // namespace par
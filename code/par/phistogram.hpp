@@ -0,0 +1,249 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "pfor.hpp"
+#include "pchunk.hpp"
+#include "bits/cpu.hpp"
+#include "bits/imath.hpp"
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// parallel histograms
+// incrementing shared counters from all jobs collapses under contention, so the counts are privatized in one of
+// several ways depending on the number of bins
+
+namespace par {
+
+enum histogram_strategy : uint32_t {
+    // choose one of the below based on the number of bins, jobs, and iterations
+    histogram_auto,
+
+    // each job counts in its own copy of the bins, the copies are summed in parallel at the end
+    // fastest when the copies fit in the caches of the cores
+    histogram_private,
+
+    // all jobs increment the shared bins atomically
+    // no extra memory, but slow when jobs often hit the same bins
+    histogram_atomic,
+
+    // each job counts in a small cache of recently hit bins and adds the counts to the shared bins atomically when
+    // they are evicted
+    // for bins which are too many to copy, especially if some of them are hit much more often than others
+    // jobs whose bins rarely repeat fall back to atomic increments
+    histogram_hybrid,
+};
+
+namespace impl {
+
+// auto chooses private copies of the bins up to this size
+inline constexpr size_t histogram_max_private_bytes = 128 * 1024;
+
+// the number of slots of the hybrid cache, a power of two
+inline constexpr uint32_t histogram_cache_slots = 256;
+
+// the hybrid cache is bypassed if it has few hits in the first adds of a job
+inline constexpr uint32_t histogram_cache_probation = 4096;
+
+template <typename C>
+FORCE_INLINE void atomic_add(C& counter, C value) {
+    std::atomic_ref<C>(counter).fetch_add(value, std::memory_order_relaxed);
+}
+
+// a direct-mapped cache of bin counts
+template <typename C>
+class histogram_cache {
+public:
+    explicit histogram_cache(C* bins) : m_bins(bins) {
+        std::fill_n(m_tags, histogram_cache_slots, empty);
+    }
+
+    histogram_cache(const histogram_cache&) = delete;
+    histogram_cache& operator=(const histogram_cache&) = delete;
+
+    ~histogram_cache() {
+        for (uint32_t i = 0; i < histogram_cache_slots; ++i) {
+            if (m_tags[i] != empty) {
+                atomic_add(m_bins[m_tags[i]], m_counts[i]);
+            }
+        }
+    }
+
+    FORCE_INLINE void add(size_t bin) {
+        if (m_bypass) {
+            atomic_add(m_bins[bin], C(1));
+            return;
+        }
+
+        const auto slot = bin & (histogram_cache_slots - 1);
+        if (m_tags[slot] == bin) {
+            ++m_counts[slot];
+            ++m_hits;
+        }
+        else {
+            if (m_tags[slot] != empty) {
+                atomic_add(m_bins[m_tags[slot]], m_counts[slot]);
+            }
+            m_tags[slot] = bin;
+            m_counts[slot] = 1;
+        }
+
+        if (++m_adds == histogram_cache_probation) {
+            // with no repeated bins (uniform data over many bins) the cache only adds overhead
+            m_bypass = m_hits < histogram_cache_probation / 8;
+        }
+    }
+
+private:
+    static constexpr size_t empty = ~size_t(0);
+    C* m_bins;
+    size_t m_tags[histogram_cache_slots];
+    C m_counts[histogram_cache_slots];
+    uint32_t m_adds = 0;
+    uint32_t m_hits = 0;
+    bool m_bypass = false;
+};
+
+} // namespace impl
+
+// add the histogram of bin_func(i) for i in [begin, end) to bins
+// bin_func returns the index of the bin, values outside of the bins (including negative ones) are ignored
+template <std::integral C, typename I, typename BinFunc>
+void phistogram(
+    thread_pool& pool,
+    run_opts opts,
+    const I begin, const I end,
+    std::span<C> bins,
+    BinFunc&& bin_func,
+    histogram_strategy strategy = histogram_auto
+) {
+    if (begin >= end || bins.empty()) return; // nothing to do
+    using U = std::make_unsigned_t<I>;
+    const U size = U(end) - U(begin);
+    const size_t num_bins = bins.size();
+
+    // jobs claim chunks of iterations, small enough for balancing and large enough to amortize the claims
+    const U num_jobs = pool.adjust_par(size, opts);
+    if (num_jobs == 0) {
+        throw std::runtime_error("unsupported nested par call");
+    }
+    const auto r = range(begin, end).job_chunk(I(std::max(U(1), size / (num_jobs * 16))));
+
+    if (num_jobs == 1) {
+        for (I i = begin; i < end; ++i) {
+            if (impl::is_cancelled(opts.cancel)) return;
+            const auto bin = size_t(bin_func(i));
+            if (bin < num_bins) ++bins[bin];
+        }
+        return;
+    }
+
+    if (strategy == histogram_auto) {
+        if (num_bins * sizeof(C) <= impl::histogram_max_private_bytes) {
+            strategy = histogram_private;
+        }
+        else if (size_t(size) < num_bins) {
+            // few hits per bin, a cache would mostly miss
+            strategy = histogram_atomic;
+        }
+        else {
+            strategy = histogram_hybrid;
+        }
+    }
+
+    if (strategy == histogram_private) {
+        // each copy starts on its own cache line
+        constexpr size_t line = std::max(size_t(1), cpu::cache_line_size / sizeof(C));
+        const size_t stride = divide_round_up(num_bins, line) * line;
+        auto copies = std::make_unique_for_overwrite<C[]>(num_jobs * stride);
+        std::vector<char> used(num_jobs); // jobs which have cleared their copy
+
+        struct private_bins {
+            C* bins;
+        };
+        pfor(pool, opts, [&](const job_info& ji) {
+            // cleared by the job itself, so that the memory is first touched by the thread which uses it
+            C* copy = copies.get() + ji.job_index * stride;
+            std::fill_n(copy, num_bins, C(0));
+            used[ji.job_index] = 1;
+            return private_bins{copy};
+        }, r, [&](I i, private_bins& pb) {
+            const auto bin = size_t(bin_func(i));
+            if (bin < num_bins) ++pb.bins[bin];
+        });
+
+        // merging few bins is not worth a parallel region
+        run_opts merge_opts = opts;
+        if (num_bins * num_jobs < 16 * 1024) {
+            merge_opts.max_par = 1;
+        }
+        pchunk(pool, merge_opts, num_bins, [&](size_t bbegin, size_t bend) {
+            for (U j = 0; j < num_jobs; ++j) {
+                if (!used[j]) continue;
+                const C* copy = copies.get() + j * stride;
+                for (size_t b = bbegin; b < bend; ++b) {
+                    bins[b] += copy[b];
+                }
+            }
+        });
+    }
+    else if (strategy == histogram_atomic) {
+        pfor(pool, opts, r, [&](I i) {
+            const auto bin = size_t(bin_func(i));
+            if (bin < num_bins) impl::atomic_add(bins[bin], C(1));
+        });
+    }
+    else {
+        pfor(pool, opts, [&](const job_info&) {
+            return impl::histogram_cache<C>(bins.data());
+        }, r, [&](I i, impl::histogram_cache<C>& cache) {
+            const auto bin = size_t(bin_func(i));
+            if (bin < num_bins) cache.add(bin);
+        });
+    }
+}
+
+template <std::integral C, typename I, typename BinFunc>
+void phistogram(
+    run_opts opts,
+    const I begin, const I end,
+    std::span<C> bins,
+    BinFunc&& bin_func,
+    histogram_strategy strategy = histogram_auto
+) {
+    phistogram(thread_pool::global(), opts, begin, end, bins, std::forward<BinFunc>(bin_func), strategy);
+}
+
+// return the histogram of bin_func(i) for i in [begin, end) with num_bins bins
+template <typename C = uint64_t, typename I, typename BinFunc>
+std::vector<C> phistogram(
+    thread_pool& pool,
+    run_opts opts,
+    const I begin, const I end,
+    size_t num_bins,
+    BinFunc&& bin_func,
+    histogram_strategy strategy = histogram_auto
+) {
+    std::vector<C> bins(num_bins);
+    phistogram(pool, opts, begin, end, std::span<C>(bins), std::forward<BinFunc>(bin_func), strategy);
+    return bins;
+}
+
+template <typename C = uint64_t, typename I, typename BinFunc>
+std::vector<C> phistogram(
+    run_opts opts,
+    const I begin, const I end,
+    size_t num_bins,
+    BinFunc&& bin_func,
+    histogram_strategy strategy = histogram_auto
+) {
+    return phistogram<C>(thread_pool::global(), opts, begin, end, num_bins, std::forward<BinFunc>(bin_func), strategy);
+}
+
+} // namespace par
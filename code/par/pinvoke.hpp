@@ -0,0 +1,75 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "thread_pool.hpp"
+#include "job_info.hpp"
+#include "cancellation_token.hpp"
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace par {
+
+namespace impl {
+
+template <typename Tuple, size_t... I>
+void invoke_nth(Tuple& funcs, uint32_t n, std::index_sequence<I...>) {
+    ((n == I ? (void)std::get<I>(funcs)() : void()), ...);
+}
+
+} // namespace impl
+
+// call each of funcs() in parallel in a single region
+// the caller thread runs the first one
+// if there are fewer jobs than functions (opts.max_par or a smaller pool), jobs which finish their function
+// claim the next unclaimed one
+template <std::invocable... Funcs>
+void pinvoke(thread_pool& pool, run_opts opts, Funcs&&... funcs) {
+    constexpr uint32_t num_funcs = sizeof...(Funcs);
+    if constexpr (num_funcs == 0) {
+        return;
+    }
+    else {
+        std::tuple<Funcs&...> ftuple(funcs...);
+        const cancellation_token* const cancel = opts.cancel;
+        auto invoke = [&](uint32_t n) {
+            impl::invoke_nth(ftuple, n, std::make_index_sequence<num_funcs>{});
+        };
+
+        const auto num_jobs = pool.adjust_par(num_funcs, opts);
+        if (num_jobs == 0) {
+            throw std::runtime_error("unsupported nested par call");
+        }
+
+        if (num_jobs == 1) {
+            // only one worker, just call the functions and skip the overhead below
+            scratch_arena::scope scratch;
+            for (uint32_t n = 0; n < num_funcs; ++n) {
+                if (impl::is_cancelled(cancel)) return;
+                invoke(n);
+            }
+            return;
+        }
+
+        // job i starts with function i, the rest are claimed
+        std::atomic_uint32_t next = num_jobs;
+        auto wfunc = [&](uint32_t ji) {
+            for (uint32_t n = ji; n < num_funcs; n = next.fetch_add(1, std::memory_order_relaxed)) {
+                if (impl::is_cancelled(cancel)) return;
+                invoke(n);
+            }
+        };
+        pool.run_task(opts, thread_pool::task_func(wfunc));
+    }
+}
+
+template <std::invocable... Funcs>
+void pinvoke(run_opts opts, Funcs&&... funcs) {
+    pinvoke(thread_pool::global(), opts, std::forward<Funcs>(funcs)...);
+}
+
+} // namespace par
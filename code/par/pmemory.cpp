@@ -0,0 +1,92 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "pmemory.hpp"
+#include <cstring>
+#include <new>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define PAR_STREAM_STORES 1
+#   include <emmintrin.h>
+#else
+#   define PAR_STREAM_STORES 0
+#endif
+
+#if defined(__linux__)
+#   include <sys/mman.h>
+#endif
+
+namespace par::impl {
+
+void* allocate_pages(size_t size, size_t alignment) {
+    void* ptr = ::operator new(size, std::align_val_t(alignment));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (alignment >= huge_page_size) {
+        // only a hint, the memory is fine without huge pages
+        madvise(ptr, size, MADV_HUGEPAGE);
+    }
+#endif
+    return ptr;
+}
+
+void free_pages(void* ptr, size_t alignment) noexcept {
+    ::operator delete(ptr, std::align_val_t(alignment));
+}
+
+void stream_copy(void* dst, const void* src, size_t size) {
+#if PAR_STREAM_STORES
+    auto d = static_cast<char*>(dst);
+    auto s = static_cast<const char*>(src);
+
+    // plain copy up to the first 16-byte boundary of the destination
+    const size_t head = std::min(size, (16 - uintptr_t(d) % 16) % 16);
+    std::memcpy(d, s, head);
+    d += head;
+    s += head;
+    size -= head;
+
+    for (; size >= 64; d += 64, s += 64, size -= 64) {
+        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+        const auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+        const auto e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+    }
+    for (; size >= 16; d += 16, s += 16, size -= 16) {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d), _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+    }
+
+    // non-temporal stores are weakly ordered, make them visible before the job finishes
+    _mm_sfence();
+
+    std::memcpy(d, s, size);
+#else
+    std::memcpy(dst, src, size);
+#endif
+}
+
+void stream_fill(void* dst, const void* pattern, size_t size) {
+    auto d = static_cast<char*>(dst);
+#if PAR_STREAM_STORES
+    const auto p = _mm_loadu_si128(static_cast<const __m128i*>(pattern));
+    for (; size >= 64; d += 64, size -= 64) {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d), p);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), p);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), p);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), p);
+    }
+    for (; size >= 16; d += 16, size -= 16) {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d), p);
+    }
+    _mm_sfence();
+#else
+    for (; size >= 16; d += 16, size -= 16) {
+        std::memcpy(d, pattern, 16);
+    }
+#endif
+}
+
+} // namespace par::impl
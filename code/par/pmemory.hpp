@@ -0,0 +1,190 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "api.h"
+#include "pchunk.hpp"
+#include "bits/cpu.hpp"
+#include "bits/imath.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+// parallel allocation, initialization, and copying of large buffers
+//
+// on NUMA machines a page is allocated on the node of the thread which first touches it, so a buffer which is
+// initialized by a single thread ends up on a single node and loops over it are limited by its bandwidth
+// pallocate and pinit initialize buffers in parallel with the partition of pfor with schedule_static and the same
+// opts.max_par over [0, size), so each worker first touches the pages it will work with
+// (the pages at the boundaries of the parts go to one of the neighbors, and huge pages are shared by more parts)
+//
+// large buffers are aligned to huge pages and on linux transparent huge pages are requested for them
+//
+// pfill and pcopy write large ranges with non-temporal (streaming) stores, which bypass the caches, as the data
+// wouldn't fit in them anyway and would only evict more useful data
+//
+// called from a thread which is not a worker of the pool, these are always scheduled statically
+// opts.cancel is ignored, as a partially initialized buffer is unusable
+
+namespace par {
+
+namespace impl {
+
+// allocations of at least this size are aligned to it
+inline constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+// fills and copies of at least this many bytes use non-temporal stores
+inline constexpr size_t stream_store_min_size = 4 * 1024 * 1024;
+
+// operator new with alignment, and a request for transparent huge pages if the alignment is huge_page_size
+PAR_API void* allocate_pages(size_t size, size_t alignment);
+PAR_API void free_pages(void* ptr, size_t alignment) noexcept;
+
+// memcpy with non-temporal stores (a plain memcpy where not supported)
+PAR_API void stream_copy(void* dst, const void* src, size_t size);
+
+// fill size bytes with a 16-byte pattern with non-temporal stores (plain stores where not supported)
+// dst must be 16-byte aligned and size a multiple of 16
+PAR_API void stream_fill(void* dst, const void* pattern, size_t size);
+
+struct pbuffer_deleter {
+    size_t alignment = alignof(std::max_align_t);
+    void operator()(void* ptr) const noexcept {
+        free_pages(ptr, alignment);
+    }
+};
+
+} // namespace impl
+
+// a buffer allocated by pallocate or pinit
+template <typename T>
+using pbuffer = std::unique_ptr<T[], impl::pbuffer_deleter>;
+
+namespace impl {
+
+template <typename T>
+pbuffer<T> allocate_pbuffer(size_t size) {
+    const size_t bytes = size * sizeof(T);
+    const size_t alignment = bytes >= huge_page_size
+        ? huge_page_size
+        : std::max(alignof(T), cpu::cache_line_size);
+    // whole huge pages, so that none of them is shared with other allocations
+    const size_t alloc_size = divide_round_up(bytes, alignment) * alignment;
+    return pbuffer<T>(static_cast<T*>(allocate_pages(alloc_size, alignment)), pbuffer_deleter{alignment});
+}
+
+inline run_opts memory_opts(const thread_pool& pool, run_opts opts) {
+    opts.cancel = nullptr;
+    if (!pool.current_thread_is_worker()) {
+        // static scheduling can't be nested
+        opts.sched = schedule_static;
+    }
+    return opts;
+}
+
+template <typename T>
+void stream_fill_n(T* data, size_t size, const T& value) {
+    if constexpr (16 % sizeof(T) == 0) {
+        constexpr size_t per_block = 16 / sizeof(T);
+
+        // plain stores up to the first 16-byte boundary
+        for (size_t i = 0; i < per_block && size && uintptr_t(data) % 16; ++i, ++data, --size) {
+            *data = value;
+        }
+
+        if (uintptr_t(data) % 16 == 0) {
+            alignas(16) unsigned char pattern[16];
+            for (size_t i = 0; i < per_block; ++i) {
+                std::memcpy(pattern + i * sizeof(T), &value, sizeof(T));
+            }
+            const size_t n = size / per_block * per_block;
+            stream_fill(data, pattern, n * sizeof(T));
+            data += n;
+            size -= n;
+        }
+    }
+    std::fill_n(data, size, value);
+}
+
+} // namespace impl
+
+// allocate a buffer of size value-initialized (zeroed) elements and first-touch it in parallel
+template <typename T>
+pbuffer<T> pallocate(thread_pool& pool, run_opts opts, size_t size) {
+    static_assert(std::is_trivial_v<T>, "pallocate requires a trivial type");
+    auto buf = impl::allocate_pbuffer<T>(size);
+    T* data = buf.get();
+    pchunk(pool, impl::memory_opts(pool, opts), size, [&](size_t begin, size_t end) {
+        std::memset(static_cast<void*>(data + begin), 0, (end - begin) * sizeof(T));
+    });
+    return buf;
+}
+
+template <typename T>
+pbuffer<T> pallocate(run_opts opts, size_t size) {
+    return pallocate<T>(thread_pool::global(), opts, size);
+}
+
+// allocate a buffer of size elements and initialize the element i with init(i) in parallel
+template <typename T, typename InitFunc>
+pbuffer<T> pinit(thread_pool& pool, run_opts opts, size_t size, InitFunc&& init) {
+    static_assert(std::is_trivially_destructible_v<T>, "pinit requires a trivially destructible type");
+    auto buf = impl::allocate_pbuffer<T>(size);
+    T* data = buf.get();
+    pchunk(pool, impl::memory_opts(pool, opts), size, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            std::construct_at(data + i, init(i));
+        }
+    });
+    return buf;
+}
+
+template <typename T, typename InitFunc>
+pbuffer<T> pinit(run_opts opts, size_t size, InitFunc&& init) {
+    return pinit<T>(thread_pool::global(), opts, size, std::forward<InitFunc>(init));
+}
+
+// set the size elements at data to value
+template <typename T>
+void pfill(thread_pool& pool, run_opts opts, T* data, size_t size, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>, "pfill requires a trivially copyable type");
+    const bool stream = size * sizeof(T) >= impl::stream_store_min_size;
+    pchunk(pool, impl::memory_opts(pool, opts), size, [&](size_t begin, size_t end) {
+        if (stream) {
+            impl::stream_fill_n(data + begin, end - begin, value);
+        }
+        else {
+            std::fill(data + begin, data + end, value);
+        }
+    });
+}
+
+template <typename T>
+void pfill(run_opts opts, T* data, size_t size, const T& value) {
+    pfill(thread_pool::global(), opts, data, size, value);
+}
+
+// copy size elements from src to dst, the ranges must not overlap
+template <typename T>
+void pcopy(thread_pool& pool, run_opts opts, const T* src, size_t size, T* dst) {
+    static_assert(std::is_trivially_copyable_v<T>, "pcopy requires a trivially copyable type");
+    const bool stream = size * sizeof(T) >= impl::stream_store_min_size;
+    pchunk(pool, impl::memory_opts(pool, opts), size, [&](size_t begin, size_t end) {
+        if (stream) {
+            impl::stream_copy(dst + begin, src + begin, (end - begin) * sizeof(T));
+        }
+        else if (end > begin) {
+            std::memcpy(static_cast<void*>(dst + begin), src + begin, (end - begin) * sizeof(T));
+        }
+    });
+}
+
+template <typename T>
+void pcopy(run_opts opts, const T* src, size_t size, T* dst) {
+    pcopy(thread_pool::global(), opts, src, size, dst);
+}
+
+} // namespace par
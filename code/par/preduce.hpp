@@ -0,0 +1,168 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "pfor.hpp"
+#include "pchunk.hpp"
+#include "bits/imath.hpp"
+#include <algorithm>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// parallel reductions: combine(init, combine(map(begin), ..., map(end - 1)))
+// combine must be associative, but the order of the operands is preserved, so it need not be commutative
+//
+// floating point addition is not associative, so the result depends on how the range is split
+// by default each job reduces its own part of the range and the parts are combined in job order, so the result
+// changes with the number of jobs
+// the deterministic mode splits the range in fixed blocks and combines them with a tree whose shape depends only on
+// the size of the range and reduce_opts::block_size, so the result is bitwise identical for any number of jobs, pool
+// size, and scheduling
+// if opts.cancel is cancelled, the result includes only the iterations which have run
+
+namespace par {
+
+struct reduce_opts {
+    bool deterministic = false;
+
+    // number of iterations reduced sequentially in deterministic mode (the leaves of the tree)
+    // results are reproducible only with the same block size
+    uint32_t block_size = 1024;
+};
+
+namespace impl {
+
+// pairwise combination of a sequence of values
+// works like a binary counter: levels[k] holds the combination of 2^k consecutive values
+// the shape of the tree depends only on the number of values
+template <typename T, typename Combine>
+class tree_combiner {
+public:
+    explicit tree_combiner(Combine& combine) : m_combine(combine) {}
+
+    void push(T value) {
+        uint32_t k = 0;
+        for (; k < max_levels && m_levels[k]; ++k) {
+            // the older value is on the left
+            value = m_combine(std::move(*m_levels[k]), std::move(value));
+            m_levels[k].reset();
+        }
+        m_levels[k].emplace(std::move(value));
+    }
+
+    std::optional<T> result() {
+        std::optional<T> ret;
+        for (uint32_t k = max_levels + 1; k-- > 0; ) {
+            if (!m_levels[k]) continue;
+            if (ret) {
+                ret.emplace(m_combine(std::move(*ret), std::move(*m_levels[k])));
+            }
+            else {
+                ret = std::move(m_levels[k]);
+            }
+        }
+        return ret;
+    }
+
+private:
+    static constexpr uint32_t max_levels = 64;
+    Combine& m_combine;
+    std::optional<T> m_levels[max_levels + 1];
+};
+
+// number of blocks claimed at once by a job of a deterministic reduction
+// a power of two, so that the trees of all groups but the last are complete
+inline constexpr uint32_t reduce_group_blocks = 16;
+
+template <typename T, typename I, typename Map, typename Combine>
+std::optional<T> sequential_reduce(I begin, I end, Map& map, Combine& combine) {
+    if (begin >= end) return std::nullopt;
+    std::optional<T> ret(map(begin));
+    for (I i = begin + 1; i < end; ++i) {
+        ret.emplace(combine(std::move(*ret), map(i)));
+    }
+    return ret;
+}
+
+} // namespace impl
+
+// map(I) -> T
+// combine(T, T) -> T
+template <typename T, typename I, typename Map, typename Combine>
+T preduce(
+    thread_pool& pool,
+    run_opts opts,
+    const reduce_opts& ropts,
+    const I begin, const I end,
+    T init,
+    Map&& map,
+    Combine&& combine
+) {
+    if (begin >= end) return init;
+    using U = std::make_unsigned_t<I>;
+    const U size = U(end) - U(begin);
+
+    std::optional<T> reduced;
+    if (ropts.deterministic) {
+        const U block_size = std::max(U(1), U(ropts.block_size));
+        const U group_size = block_size * impl::reduce_group_blocks;
+        const U num_groups = divide_round_up(size, group_size);
+
+        std::vector<std::optional<T>> group_results(num_groups);
+        pfor(pool, opts, U(0), num_groups, [&](U g) {
+            impl::tree_combiner<T, std::remove_reference_t<Combine>> tree(combine);
+            const U gbegin = g * group_size;
+            const U gend = std::min(gbegin + group_size, size);
+            for (U b = gbegin; b < gend; b += block_size) {
+                const U bend = std::min(b + block_size, size);
+                tree.push(*impl::sequential_reduce<T>(I(U(begin) + b), I(U(begin) + bend), map, combine));
+            }
+            group_results[g] = tree.result();
+        });
+
+        // the groups are combined with another tree in their order, regardless of which jobs reduced them
+        impl::tree_combiner<T, std::remove_reference_t<Combine>> tree(combine);
+        for (auto& r : group_results) {
+            if (r) tree.push(std::move(*r));
+        }
+        reduced = tree.result();
+    }
+    else {
+        const auto num_jobs = pool.adjust_par(size, opts);
+        std::vector<std::optional<T>> job_results(num_jobs);
+        pchunk(pool, opts, size, [&](U cbegin, U cend, const job_info& ji) {
+            job_results[ji.job_index] = impl::sequential_reduce<T>(I(U(begin) + cbegin), I(U(begin) + cend), map, combine);
+        });
+
+        for (auto& r : job_results) {
+            if (!r) continue;
+            if (reduced) {
+                reduced.emplace(combine(std::move(*reduced), std::move(*r)));
+            }
+            else {
+                reduced = std::move(r);
+            }
+        }
+    }
+
+    if (!reduced) return init; // cancelled before any iterations ran
+    return combine(std::move(init), std::move(*reduced));
+}
+
+template <typename T, typename I, typename Map, typename Combine>
+T preduce(thread_pool& pool, run_opts opts, const I begin, const I end, T init, Map&& map, Combine&& combine) {
+    return preduce(pool, opts, reduce_opts{}, begin, end, std::move(init), std::forward<Map>(map), std::forward<Combine>(combine));
+}
+
+template <typename T, typename I, typename Map, typename Combine>
+T preduce(run_opts opts, const reduce_opts& ropts, const I begin, const I end, T init, Map&& map, Combine&& combine) {
+    return preduce(thread_pool::global(), opts, ropts, begin, end, std::move(init), std::forward<Map>(map), std::forward<Combine>(combine));
+}
+
+template <typename T, typename I, typename Map, typename Combine>
+T preduce(run_opts opts, const I begin, const I end, T init, Map&& map, Combine&& combine) {
+    return preduce(thread_pool::global(), opts, reduce_opts{}, begin, end, std::move(init), std::forward<Map>(map), std::forward<Combine>(combine));
+}
+
+} // namespace par
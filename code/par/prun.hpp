@@ -12,9 +12,11 @@ template <std::invocable<uint32_t> TaskFunc>
 uint32_t prun(thread_pool& pool, run_opts opts, TaskFunc&& func) {
     if (opts.max_par == 1) {
         // only one worker, just call the function and skip the overhead below
+        scratch_arena::scope scratch;
         func(0);
         return 1;
     }
+    opts.max_par = pool.get_par(opts);
     return pool.run_task(opts, thread_pool::task_func(func));
 }
 
@@ -23,9 +25,13 @@ uint32_t prun(thread_pool& pool, run_opts opts, TaskFunc&& func) {
     const auto par = pool.get_par(opts);
     if (par == 1) {
         // only one worker, just call the function and skip the overhead below
+        scratch_arena::scope scratch;
         func(job_info{0, 1});
         return 1;
     }
+    // the jobs are told their number, so it must not change
+    opts.max_par = par;
+    opts.max_par_adjusted = true;
     auto wfunc = [&](uint32_t i) {
         job_info arg{i, par};
         func(arg);
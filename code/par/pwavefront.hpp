@@ -0,0 +1,243 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "thread_pool.hpp"
+#include "job_info.hpp"
+#include "cancellation_token.hpp"
+#include "bits/cpu.hpp"
+#include <splat/inline.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace par {
+
+namespace impl {
+
+template <typename Func>
+FORCE_INLINE void invoke_wavefront_func(uint32_t i, uint32_t j, [[maybe_unused]] const job_info& ji, Func& func) {
+    if constexpr (std::is_invocable_v<Func, uint32_t, uint32_t, const job_info&>) {
+        func(i, j, ji);
+    }
+    else {
+        func(i, j);
+    }
+}
+
+// dependency counters of the tiles and a queue of the tiles which are ready to run
+// each tile is queued at most once, so the queue is an array with a claim and a publish index
+class wavefront_state {
+public:
+    static constexpr uint32_t none = ~uint32_t(0);
+
+    wavefront_state(uint32_t rows, uint32_t cols)
+        : m_rows(rows)
+        , m_cols(cols)
+        , m_num_tiles(rows * cols)
+        , m_deps(m_num_tiles)
+        , m_ready(m_num_tiles)
+    {
+        for (uint32_t i = 0; i < rows; ++i) {
+            for (uint32_t j = 0; j < cols; ++j) {
+                m_deps[i * cols + j].store(uint8_t(!!i + !!j), std::memory_order_relaxed);
+            }
+        }
+        for (auto& r : m_ready) {
+            r.store(none, std::memory_order_relaxed);
+        }
+        m_ready[0].store(0, std::memory_order_relaxed);
+        m_tail.store(1, std::memory_order_relaxed);
+    }
+
+    // claim a ready tile, wait if there are none, but others are still running
+    // return none when all tiles are done or the loop is stopped
+    uint32_t pop() {
+        uint32_t spins = 0;
+        while (true) {
+            const auto events = m_events.load(std::memory_order_acquire);
+            if (m_stopped.load(std::memory_order_relaxed)) return none;
+
+            auto h = m_head.load(std::memory_order_relaxed);
+            if (h < m_num_tiles) {
+                const auto tile = m_ready[h].load(std::memory_order_acquire);
+                if (tile != none) {
+                    if (m_head.compare_exchange_weak(h, h + 1, std::memory_order_relaxed)) {
+                        return tile;
+                    }
+                    continue;
+                }
+            }
+            if (m_num_done.load(std::memory_order_acquire) == m_num_tiles) return none;
+
+            // the next tile depends on tiles which are running
+            if (spins < idle_spin_count) {
+                ++spins;
+                cpu::relax();
+                continue;
+            }
+            m_num_waiters.fetch_add(1, std::memory_order_seq_cst);
+            if (m_events.load(std::memory_order_seq_cst) == events) {
+                m_events.wait(events, std::memory_order_seq_cst);
+            }
+            m_num_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // mark tile (i, j) as done and return a dependent tile which became ready for the caller to run next (the tile
+    // to the right, whose data is closer), the other is queued
+    uint32_t finish(uint32_t i, uint32_t j) {
+        const uint32_t tile = i * m_cols + j;
+        uint32_t next = none;
+        if (j + 1 < m_cols && m_deps[tile + 1].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            next = tile + 1;
+        }
+        if (i + 1 < m_rows && m_deps[tile + m_cols].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (next == none) {
+                next = tile + m_cols;
+            }
+            else {
+                push(tile + m_cols);
+            }
+        }
+        if (m_num_done.fetch_add(1, std::memory_order_acq_rel) + 1 == m_num_tiles) {
+            signal(true);
+        }
+        return next;
+    }
+
+    void stop() {
+        m_stopped.store(true, std::memory_order_relaxed);
+        signal(true);
+    }
+
+private:
+    // number of checks for a ready tile before waiting
+    static constexpr uint32_t idle_spin_count = 1000;
+
+    void push(uint32_t tile) {
+        const auto slot = m_tail.fetch_add(1, std::memory_order_relaxed);
+        m_ready[slot].store(tile, std::memory_order_release);
+        signal(false);
+    }
+
+    void signal(bool all) {
+        m_events.fetch_add(1, std::memory_order_seq_cst);
+        if (m_num_waiters.load(std::memory_order_seq_cst)) {
+            if (all) {
+                m_events.notify_all();
+            }
+            else {
+                m_events.notify_one();
+            }
+        }
+    }
+
+    const uint32_t m_rows;
+    const uint32_t m_cols;
+    const uint32_t m_num_tiles;
+
+    // number of unfinished tiles each tile depends on
+    std::vector<std::atomic_uint8_t> m_deps;
+
+    std::vector<std::atomic_uint32_t> m_ready;
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_uint32_t m_head = 0;
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_uint32_t m_tail = 0;
+
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_uint32_t m_num_done = 0;
+    std::atomic_bool m_stopped = false;
+
+    // changes when a tile is queued, all tiles are done, or the loop is stopped
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_uint32_t m_events = 0;
+    std::atomic_uint32_t m_num_waiters = 0;
+};
+
+} // namespace impl
+
+// call func(i, j) or func(i, j, job_info) for each tile of a rows x cols grid, after the tiles (i - 1, j) and
+// (i, j - 1) have finished
+// for dynamic programming (edit distance, Smith-Waterman) and Gauss-Seidel sweeps, split into tiles of cells
+//
+// instead of a fork-join per anti-diagonal, each tile has an atomic counter of its unfinished dependencies and
+// the tile which brings it to zero makes it ready, so tiles of several diagonals run concurrently
+// a job runs the ready tile to the right of the one it finished (if any) and queues the one below for any job
+// there are no more jobs than tiles in the longest anti-diagonal: min(rows, cols)
+//
+// all scheduling strategies run ready tiles dynamically, static scheduling only affects nesting
+// with opts.cancel, jobs stop before the next tile once it's cancelled
+// if func throws, the other jobs stop and the first exception propagates, no matter which thread threw it
+template <typename Func>
+void pwavefront(thread_pool& pool, run_opts opts, uint32_t rows, uint32_t cols, Func&& func) {
+    if (rows == 0 || cols == 0) return;
+    if (uint64_t(rows) * cols >= std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("par::pwavefront: too many tiles");
+    }
+    const cancellation_token* const cancel = opts.cancel;
+
+    const auto num_jobs = pool.adjust_par(std::min(rows, cols), opts);
+    if (num_jobs == 0) {
+        throw std::runtime_error("unsupported nested par call");
+    }
+
+    if (num_jobs == 1) {
+        // row by row satisfies the dependencies
+        scratch_arena::scope scratch;
+        const job_info ji{0, 1};
+        for (uint32_t i = 0; i < rows; ++i) {
+            for (uint32_t j = 0; j < cols; ++j) {
+                if (impl::is_cancelled(cancel)) return;
+                impl::invoke_wavefront_func(i, j, ji, func);
+            }
+        }
+        return;
+    }
+
+    impl::wavefront_state state(rows, cols);
+    std::atomic_flag failed = ATOMIC_FLAG_INIT;
+    std::exception_ptr error;
+    auto wfunc = [&](uint32_t ji) {
+        const job_info info{ji, num_jobs};
+        uint32_t tile = impl::wavefront_state::none;
+        while (true) {
+            if (tile == impl::wavefront_state::none) {
+                tile = state.pop();
+                if (tile == impl::wavefront_state::none) return;
+            }
+            if (impl::is_cancelled(cancel)) {
+                state.stop();
+                return;
+            }
+            const uint32_t i = tile / cols;
+            const uint32_t j = tile % cols;
+            try {
+                impl::invoke_wavefront_func(i, j, info, func);
+            }
+            catch (...) {
+                // rethrown after all jobs are done, as they use the state
+                if (!failed.test_and_set(std::memory_order_relaxed)) {
+                    error = std::current_exception();
+                }
+                // the dependent tiles will never be ready, don't let the other jobs wait for them
+                state.stop();
+                return;
+            }
+            tile = state.finish(i, j);
+        }
+    };
+    pool.run_task(opts, thread_pool::task_func(wfunc));
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename Func>
+void pwavefront(run_opts opts, uint32_t rows, uint32_t cols, Func&& func) {
+    pwavefront(thread_pool::global(), opts, rows, cols, std::forward<Func>(func));
+}
+
+} // namespace par
@@ -6,6 +6,9 @@
 
 namespace par {
 
+class cancellation_token;
+class affinity_partitioner;
+
 // this is not an enum class because `static` is a keyword and not usable as a symbol
 enum schedule : uint32_t {
     // dynamic scheduling with work stealing, allows nested parallelism
@@ -20,6 +23,12 @@ enum schedule : uint32_t {
     // throw an exception when used on a nested call as nesting can cause deadlocks
     schedule_static,
 
+    // dynamic scheduling which hands blocks of iterations to the workers which ran them in the previous loop with
+    // the same run_opts::affinity, with stealing for balance
+    // for loops repeated over the same data, which thus stays in the caches of the same cores
+    // loops which don't support it (or without run_opts::affinity) treat it as schedule_dynamic
+    schedule_affinity,
+
     // REMOVED as it's was deemed not practical
     // dynamic scheduling with work stealing, allow nested parallelism
     // and also execute other jobs while waiting
@@ -34,6 +43,23 @@ enum schedule : uint32_t {
     // schedule_only_parallel,
 };
 
+// priority of the dynamic jobs of a task when multiple tasks compete for the workers of a pool
+enum priority_class : uint32_t {
+    // latency-critical work, workers pick it up before anything else
+    priority_high,
+
+    // the default
+    priority_normal,
+
+    // batch work, never dispatched directly to workers, but only queued for them
+    // thus workers pick up higher priority work at job boundaries
+    // dynamically scheduled loops (pfor) also end background jobs early when there is higher priority work
+    // the caller thread (job 0) always finishes what's left
+    priority_background,
+};
+
+inline constexpr uint32_t num_priority_classes = 3;
+
 struct run_opts {
     schedule sched = schedule_dynamic;
 
@@ -46,6 +72,22 @@ struct run_opts {
     // dynamic: the task instances may eventually run on a single thread or few threads when there's other work,
     // static: each task instance will run on a separate thread (again, clamped to the number of workers + 1)
     uint32_t max_par = 0;
+
+    // ignored by static scheduling, where each job has its own thread anyway
+    priority_class priority = priority_normal;
+
+    // checked by loops (pfor, dynamically scheduled pchunk) before each iteration or chunk is handed out
+    // nullptr means not cancellable
+    // see cancellation_token.hpp
+    cancellation_token* cancel = nullptr;
+
+    // used by schedule_affinity, see affinity_partitioner.hpp
+    affinity_partitioner* affinity = nullptr;
+
+    // set by thread_pool::adjust_par
+    // max_par is then the exact number of jobs to run, even if the pool shrinks before the task is run
+    // otherwise it's clamped to the current number of workers + 1
+    bool max_par_adjusted = false;
 };
 
 // optionally use this as an argument to make it explicit that default options are used
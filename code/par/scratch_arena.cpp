@@ -0,0 +1,52 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include "scratch_arena.hpp"
+#include "bits/cpu.hpp"
+#include <algorithm>
+#include <new>
+
+namespace par {
+
+namespace {
+constexpr std::align_val_t block_alignment{cpu::alignment_to_avoid_false_sharing};
+}
+
+scratch_arena::~scratch_arena() {
+    for (auto& b : m_blocks) {
+        ::operator delete(b.data, block_alignment);
+    }
+}
+
+void* scratch_arena::allocate_slow(size_t size, size_t alignment) {
+    // enough for any alignment of the allocation
+    const size_t needed = size + alignment;
+
+    // blocks after the current one are free and kept after rewinds
+    size_t next = m_blocks.empty() ? 0 : m_cur_block + 1;
+    while (next < m_blocks.size() && m_blocks[next].size < needed) {
+        // too small, it will be replaced by a bigger one
+        ::operator delete(m_blocks[next].data, block_alignment);
+        m_blocks.erase(m_blocks.begin() + next);
+    }
+
+    if (next == m_blocks.size()) {
+        const size_t prev_size = m_blocks.empty() ? initial_block_size / 2 : m_blocks.back().size;
+        const size_t bsize = std::max(prev_size * 2, needed);
+        m_blocks.push_back({static_cast<std::byte*>(::operator new(bsize, block_alignment)), bsize});
+    }
+
+    m_cur_block = next;
+    m_offset = 0;
+    return allocate(size, alignment);
+}
+
+size_t scratch_arena::capacity() const {
+    size_t ret = 0;
+    for (auto& b : m_blocks) {
+        ret += b.size;
+    }
+    return ret;
+}
+
+} // namespace par
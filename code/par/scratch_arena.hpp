@@ -0,0 +1,98 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "api.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace par {
+
+// a bump allocator for temporary memory of jobs
+// each worker of a thread pool owns one and other threads have a thread-local one
+// jobs get the one of the thread they run on through job_info::scratch()
+// everything allocated by a job is released when the job ends, but the memory is kept for the next jobs
+// a job may run many loop iterations, so use a scope for temporaries of single iterations
+// blocks are allocated and first touched by the thread which uses them, so they are local to its NUMA node
+// when a block is exhausted, the next one is twice as big
+class PAR_API scratch_arena {
+public:
+    scratch_arena() = default;
+    ~scratch_arena();
+
+    scratch_arena(const scratch_arena&) = delete;
+    scratch_arena& operator=(const scratch_arena&) = delete;
+
+    // the size of the first block
+    static constexpr size_t initial_block_size = 64 * 1024;
+
+    // alignment must be a power of two
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        if (m_cur_block < m_blocks.size()) {
+            auto& b = m_blocks[m_cur_block];
+            const auto base = reinterpret_cast<uintptr_t>(b.data);
+            const auto begin = ((base + m_offset + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+            if (begin + size <= b.size) {
+                m_offset = begin + size;
+                return b.data + begin;
+            }
+        }
+        return allocate_slow(size, alignment);
+    }
+
+    // uninitialized storage for n objects
+    template <typename T>
+    T* allocate(size_t n) {
+        static_assert(std::is_trivially_destructible_v<T>, "scratch objects are never destroyed");
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+    }
+
+    struct marker {
+        size_t block;
+        size_t offset;
+    };
+
+    marker mark() const { return {m_cur_block, m_offset}; }
+
+    // release everything allocated after the marker
+    void rewind(marker m) {
+        m_cur_block = m.block;
+        m_offset = m.offset;
+    }
+
+    // rewind the arena on destruction
+    class scope {
+        scratch_arena& m_arena;
+        marker m_marker;
+    public:
+        explicit scope(scratch_arena& arena = current())
+            : m_arena(arena)
+            , m_marker(arena.mark())
+        {}
+        ~scope() { m_arena.rewind(m_marker); }
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+    };
+
+    // total size of the allocated blocks
+    size_t capacity() const;
+
+    // the arena of the current thread
+    static scratch_arena& current();
+
+private:
+    struct block {
+        std::byte* data;
+        size_t size;
+    };
+    std::vector<block> m_blocks;
+    size_t m_cur_block = 0;
+    size_t m_offset = 0; // in m_blocks[m_cur_block]
+
+    void* allocate_slow(size_t size, size_t alignment);
+};
+
+} // namespace par
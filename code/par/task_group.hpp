@@ -0,0 +1,69 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "api.h"
+#include "thread_pool.hpp"
+#include "bits/inplace_task.hpp"
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+namespace par {
+
+// recursive fork-join: spawn tasks, then wait for them
+// for divide and conquer algorithms (quicksort, tree traversals) which don't map to loops
+//
+// spawned tasks are queued on the thread which spawns them, which runs them last in first out when it waits (so
+// it descends depth-first like a sequential recursion), while idle workers of the pool steal them first in first out
+// (the biggest pieces of work are the oldest ones)
+// a thread which waits for a group runs queued tasks of any group until its own are done, so threads don't block
+// while there is work, no matter how deep the recursion
+// tasks can spawn more tasks in their own groups
+//
+// the callables of tasks are stored in an inplace_task (callables which don't fit are a compilation error)
+// if tasks throw, the first exception propagates from the wait() of their group, on whichever thread they ran
+class PAR_API task_group {
+public:
+    using task = inplace_task<void()>;
+
+    explicit task_group(thread_pool& pool);
+    task_group() : task_group(thread_pool::global()) {}
+
+    // waits for the tasks, exceptions which no wait() has rethrown are dropped
+    ~task_group();
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    thread_pool& pool() const { return m_pool; }
+
+    template <typename F>
+    void spawn(F&& func) {
+        spawn_task(task(std::forward<F>(func)));
+    }
+
+    // run tasks until all tasks of the group have finished
+    // the group can be reused after it returns (or throws)
+    void wait();
+
+    // spawned tasks which haven't finished yet
+    uint32_t num_pending() const {
+        return m_num_pending.load(std::memory_order_acquire);
+    }
+
+private:
+    void spawn_task(task t);
+
+    thread_pool& m_pool;
+    std::atomic_uint32_t m_num_pending = 0;
+
+    // the first exception thrown by a task, set by the thread which sets m_failed
+    std::atomic_flag m_failed = ATOMIC_FLAG_INIT;
+    std::exception_ptr m_exception;
+
+    friend struct thread_pool::impl;
+};
+
+} // namespace par
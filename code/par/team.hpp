@@ -0,0 +1,195 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#pragma once
+#include "thread_pool.hpp"
+#include "job_info.hpp"
+#include "pfor.hpp"
+#include "bits/cpu.hpp"
+#include "bits/imath.hpp"
+#include <splat/inline.h>
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <stdexcept>
+#include <type_traits>
+
+// team: a parallel region with multiple worksharing loops
+// the equivalent of:
+//   #pragma omp parallel
+//   {
+//       #pragma omp for
+//       for (...) {}
+//       #pragma omp for nowait
+//       for (...) {}
+//   }
+// all jobs of a team run concurrently on separate threads (static scheduling)
+// and can synchronize with each other through barriers
+
+#include <splat/warnings.h>
+PRAGMA_WARNING_PUSH
+DISABLE_MSVC_WARNING(4324)
+
+namespace par {
+
+struct team_for_opts {
+    // schedule_static: each job processes a contiguous part of the range (the same as with pfor)
+    // schedule_dynamic: jobs grab indices as they finish previous ones
+    //   dynamic loops always end with a barrier (nowait is ignored)
+    schedule sched = schedule_static;
+
+    // skip the implicit barrier at the end of the loop
+    bool nowait = false;
+};
+
+namespace impl {
+
+struct team_state {
+    // reset the dynamic loop slot when all jobs arrive at a barrier
+    // dynamic loops end with a barrier, so no job can be in the middle of one at this point
+    struct on_barrier {
+        std::atomic_uint64_t* slot;
+        void operator()() noexcept {
+            slot->store(0, std::memory_order_relaxed);
+        }
+    };
+
+    explicit team_state(uint32_t num_jobs)
+        : barrier(num_jobs, on_barrier{&dynamic_slot})
+    {}
+
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_uint64_t dynamic_slot = 0;
+    alignas(cpu::alignment_to_avoid_false_sharing) std::barrier<on_barrier> barrier;
+};
+
+} // namespace impl
+
+// a single job of a team
+// every job must encounter the same sequence of loops, singles, and barriers
+class team {
+    impl::team_state& m_state;
+    job_info m_info;
+public:
+    team(impl::team_state& state, job_info info)
+        : m_state(state)
+        , m_info(info)
+    {}
+
+    team(const team&) = delete;
+    team& operator=(const team&) = delete;
+
+    const job_info& info() const { return m_info; }
+    uint32_t job_index() const { return m_info.job_index; }
+    uint32_t num_jobs() const { return m_info.num_jobs; }
+
+    // wait for all jobs of the team to arrive
+    void barrier() {
+        m_state.barrier.arrive_and_wait();
+    }
+
+    template <typename I, typename Func>
+    void pfor(team_for_opts opts, const I begin, const I end, Func&& func) {
+        if (begin < end) {
+            using U = std::make_unsigned_t<I>;
+            const U size = U(end) - U(begin);
+
+            if (opts.sched == schedule_static) {
+                const U worker_part = divide_round_up(size, U(m_info.num_jobs));
+                const U wbegin = std::min(U(m_info.job_index) * worker_part, size);
+                const U wend = std::min(wbegin + worker_part, size);
+                for (U i = wbegin; i < wend; ++i) {
+                    func(I(U(begin) + i));
+                }
+            }
+            else {
+                while (true) {
+                    const U i = U(m_state.dynamic_slot.fetch_add(1, std::memory_order_relaxed));
+                    if (i >= size) break; // all done
+                    func(I(U(begin) + i));
+                }
+                opts.nowait = false; // the slot must be reset before the next dynamic loop
+            }
+        }
+
+        if (!opts.nowait) {
+            barrier();
+        }
+    }
+
+    template <typename I, typename Func>
+    void pfor(const I begin, const I end, Func&& func) {
+        pfor(team_for_opts{}, begin, end, std::forward<Func>(func));
+    }
+
+    // execute func on a single job of the team (the caller thread)
+    template <typename Func>
+    void single(team_for_opts opts, Func&& func) {
+        if (m_info.job_index == 0) {
+            func();
+        }
+        if (!opts.nowait) {
+            barrier();
+        }
+    }
+
+    template <typename Func>
+    void single(Func&& func) {
+        single(team_for_opts{}, std::forward<Func>(func));
+    }
+};
+
+namespace impl {
+template <typename JobData, typename Func>
+FORCE_INLINE void invoke_team_func(team& t, JobData& data, Func& func) {
+    if constexpr (std::is_invocable_v<Func, team&, JobData&>) {
+        func(t, data);
+    }
+    else {
+        func(t);
+    }
+}
+} // namespace impl
+
+// run func once per job of the team
+// func: void(team&) or void(team&, JobData&)
+// JobData is constructed once per job and persists across all loops of the team
+// opts.sched is ignored: teams are always statically scheduled, and as such cannot be nested
+// for the same reason, don't run other statically scheduled tasks on the same pool from within a team, and don't
+// shrink the pool while a team is starting
+// return the number of jobs in the team
+template <typename JobData = job_info, typename Func>
+uint32_t pteam(thread_pool& pool, run_opts opts, Func&& func) {
+    opts.sched = schedule_static;
+    const uint32_t num_jobs = pool.get_par(opts);
+    if (num_jobs == 0) {
+        throw std::runtime_error("unsupported nested par call");
+    }
+    opts.max_par = num_jobs;
+    opts.max_par_adjusted = true; // the barriers wait for exactly this many jobs
+
+    impl::team_state state(num_jobs);
+
+    auto wfunc = [&](uint32_t ji) {
+        team t(state, job_info{ji, num_jobs});
+        JobData data = impl::default_job_data_init<JobData>(t.info());
+        impl::invoke_team_func(t, data, func);
+    };
+
+    if (num_jobs == 1) {
+        // only one job, skip the overhead of run_task
+        scratch_arena::scope scratch;
+        wfunc(0);
+        return 1;
+    }
+
+    return pool.run_task(opts, thread_pool::task_func(wfunc));
+}
+
+template <typename JobData = job_info, typename Func>
+uint32_t pteam(run_opts opts, Func&& func) {
+    return pteam<JobData>(thread_pool::global(), opts, std::forward<Func>(func));
+}
+
+} // namespace par
+
+PRAGMA_WARNING_POP
@@ -2,22 +2,29 @@
 // SPDX-License-Identifier: MIT
 //
 #include "thread_pool.hpp"
+#include "cpu_limits.hpp"
+#include "federation.hpp"
+#include "scratch_arena.hpp"
+#include "task_group.hpp"
 #include "bits/anchor.hpp"
 #include "bits/cpu.hpp"
 #include "bits/thread_name.hpp"
-#include <itlib/qalgorithm.hpp>
 #include <vector>
+#include <deque>
 #include <atomic>
 #include <latch>
 #include <mutex>
+#include <shared_mutex>
 #include <thread>
 #include <condition_variable>
 #include <stdexcept>
 #include <string>
 #include <cassert>
-#include <deque>
 #include <optional>
+#include <memory>
+#include <utility>
 
+#include <splat/inline.h>
 #include <splat/warnings.h>
 DISABLE_MSVC_WARNING(4324)
 
@@ -37,84 +44,683 @@ namespace {
 
 thread_local thread_pool::impl* current_pool = nullptr;
 
+// the pool of a worker which is executing a job of another pool in the same federation
+// in that case current_pool is the other pool
+thread_local thread_pool::impl* lender_pool = nullptr;
+
+// the scratch arena of the worker running on this thread, nullptr for other threads
+thread_local scratch_arena* worker_scratch = nullptr;
+
+// the index of the worker running on this thread in its pool (lender_pool if set, otherwise current_pool)
+thread_local uint32_t worker_index = 0;
+
+// functions of thread_pool::at_region_end, called when the outermost region_scope of the thread ends
+thread_local uint32_t region_depth = 0;
+thread_local std::vector<thread_pool::completion_func> region_end_funcs;
+
+// a region of the caller, or a job of a worker
+struct region_scope {
+    region_scope() {
+        ++region_depth;
+    }
+    ~region_scope() {
+        if (--region_depth) return;
+        // funcs which are added from now on are rejected, so this doesn't change while iterating
+        for (auto& f : region_end_funcs) {
+            f();
+        }
+        region_end_funcs.clear();
+    }
+    region_scope(const region_scope&) = delete;
+    region_scope& operator=(const region_scope&) = delete;
+};
+
 struct worker_task {
     uint32_t index;
     thread_pool::task_func func;
     std::latch* latch = nullptr; // have nullptr here when stopping
 
     void operator()() {
-        func(index);
+        {
+            region_scope region;
+            scratch_arena::scope scratch; // release the scratch memory of the job
+            func(index);
+        }
         latch->count_down();
     }
 };
 
-struct pending_dynamic_task {
-    // index of last executed item (assigned is ignored)
-    uint32_t index = 0;
+// a dynamic region whose jobs could not all be given to idle workers
+// it lives in the stack frame of the caller, which unlinks it from its shard before returning
+// thus the caller claims its own jobs through a direct handle and without locking
+struct pending_region {
+    // index of the last claimed job
+    // may overshoot size when jobs are claimed concurrently
+    std::atomic_uint32_t claimed;
 
-    uint32_t size = 0; // nthreads, basically
+    const uint32_t size; // nthreads, basically
 
     thread_pool::task_func func;
 
     std::latch& latch;
 
-    pending_dynamic_task(uint32_t i, uint32_t n, const thread_pool::task_func& f, std::latch& l)
-        : index(i)
+    const priority_class priority;
+    const uint32_t shard;
+
+    // intrusive list of the shard, protected by its mutex
+    pending_region* prev = nullptr;
+    pending_region* next = nullptr;
+    bool linked = false;
+
+    pending_region(uint32_t i, uint32_t n, const thread_pool::task_func& f, std::latch& l, priority_class p, uint32_t s)
+        : claimed(i)
         , size(n)
         , func(f)
         , latch(l)
+        , priority(p)
+        , shard(s)
     {}
 
-    bool done() const {
-        return index == size;
+    std::optional<worker_task> claim() {
+        // avoid the read-modify-write on exhausted regions
+        if (claimed.load(std::memory_order_relaxed) >= size) return std::nullopt;
+        const auto index = claimed.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (index > size) return std::nullopt;
+        return worker_task{index, func, &latch};
     }
+};
 
-    worker_task get_next_worker_task() {
-        assert(index < size);
-        worker_task wt;
-        wt.index = ++index;
-        wt.func = func;
-        wt.latch = &latch;
-        return wt;
+// pending regions are distributed among shards, so that concurrent submitters don't contend for a single mutex
+constexpr uint32_t num_submission_shards = 8;
+
+std::atomic_uint32_t next_shard_hint = 0;
+
+// submitters link regions to this shard and workers start searching for regions from it
+thread_local const uint32_t shard_hint = next_shard_hint.fetch_add(1, std::memory_order_relaxed);
+
+// the state of the broadcast region packed in a single 64-bit word, so that publishing a region is a single store
+//   bits 32-63: generation
+//   bit 31: static region (worker N runs job N + 1)
+//   bits 16-30: number of worker jobs
+//   bits 0-15: number of claimed jobs (dynamic regions only)
+struct broadcast_state {
+    uint32_t gen = 0;
+    bool is_static = false;
+    uint32_t size = 0;
+    uint32_t claimed = 0;
+
+    static constexpr uint32_t max_size = 0x7FFF;
+    static_assert(max_size == thread_pool::max_threads_limit);
+
+    static broadcast_state unpack(uint64_t raw) {
+        return {
+            uint32_t(raw >> 32),
+            !!(raw & 0x8000'0000),
+            uint32_t(raw >> 16) & max_size,
+            uint32_t(raw) & 0xFFFF,
+        };
+    }
+
+    uint64_t pack() const {
+        return (uint64_t(gen) << 32) | (is_static ? 0x8000'0000 : 0) | (uint64_t(size) << 16) | claimed;
     }
 };
 
+// increment counter unless it has reached limit
+bool try_increment(std::atomic_uint32_t& counter, uint32_t limit) {
+    auto n = counter.load(std::memory_order_relaxed);
+    do {
+        if (n >= limit) return false;
+    } while (!counter.compare_exchange_weak(n, n + 1, std::memory_order_relaxed));
+    return true;
+}
+
+// set value to n unless it's already greater
+void raise_to(std::atomic_uint32_t& value, uint32_t n) {
+    auto cur = value.load(std::memory_order_relaxed);
+    while (cur < n && !value.compare_exchange_weak(cur, n, std::memory_order_seq_cst)) {}
+}
+
+// number of checks for new work an idle worker does before going to sleep
+// regions launched in quick succession thus find the workers awake and are dispatched without syscalls
+constexpr uint32_t idle_spin_count = 2000;
+
 } // namespace
 
+struct federation::impl {
+    // members are only added and removed with a unique lock
+    std::shared_mutex m_mutex;
+    std::vector<thread_pool::impl*> m_members;
+
+    // set when a member queues dynamic jobs, cleared by workers which search for jobs to borrow
+    std::atomic_flag m_have_pending = ATOMIC_FLAG_INIT;
+};
+
 struct thread_pool::impl {
     std::string m_name;
 
+    scaling_opts m_scaling;
+
+    // number of running workers
+    // m_workers has max_threads elements, and the first m_num_threads of them are running
+    // changes only while the broadcast region is acquired, so that static regions see a consistent set of workers
+    std::atomic_uint32_t m_num_threads = 0;
+
+    // workers of lazy pools which are started only when a task needs them
+    // the pool is sized for m_num_threads + m_num_lazy_threads workers
+    // changes only while the broadcast region is acquired, like m_num_threads
+    std::atomic_uint32_t m_num_lazy_threads = 0;
+
+    // serializes resizing
+    std::mutex m_resize_mutex;
+
+    // lazy workers which callers that must not wait couldn't start, because the pool was busy resizing
+    // whoever holds m_resize_mutex starts them after releasing it
+    std::atomic_uint32_t m_num_wanted_lazy_threads = 0;
+
     #if PAR_DEBUG_STATS
     debug_stats m_own_debug_stats;
     debug_stats& m_debug_stats;
     debug_stats::worker_stats& m_caller_stats;
     #endif
 
-    std::atomic_flag m_have_dynamic_tasks = ATOMIC_FLAG_INIT;
+    // number of linked pending regions per priority class
+    std::atomic_uint32_t m_num_pending_regions[num_priority_classes] = {};
 
-    std::mutex m_dynamic_task_mutex;
-    std::deque<pending_dynamic_task> m_pending_dynamic_tasks;
+    bool have_pending_dynamic_tasks(priority_class lowest, std::memory_order order) const {
+        for (uint32_t p = 0; p <= lowest; ++p) {
+            if (m_num_pending_regions[p].load(order)) return true;
+        }
+        return false;
+    }
 
-    std::optional<worker_task> get_pending_dynamic_task() {
-        if (!m_have_dynamic_tasks.test(std::memory_order_acquire)) {
-            return std::nullopt;
+    // broadcast dispatch
+    // static and full-pool regions are not added to workers one by one
+    // instead the caller publishes a single region which idle workers watch for
+    // static regions are always broadcast and only one broadcast region exists at a time, so concurrent static
+    // regions are picked up by all workers in the same order
+    // regions whose jobs wait for each other (like team barriers) would otherwise deadlock
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_uint64_t m_broadcast_state = 0;
+
+    // set while the region descriptor is in use (until all jobs are picked up)
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_flag m_broadcast_busy = ATOMIC_FLAG_INIT;
+    std::atomic_uint32_t m_broadcast_pickups = 0;
+    thread_pool::task_func m_broadcast_func;
+    std::latch* m_broadcast_latch = nullptr;
+
+    // number of workers which are blocked on their condition variable
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_uint32_t m_num_sleeping = 0;
+
+    bool try_acquire_broadcast_region() {
+        return !m_broadcast_busy.test(std::memory_order_relaxed)
+            && !m_broadcast_busy.test_and_set(std::memory_order_acquire);
+    }
+
+    void acquire_broadcast_region() {
+        while (m_broadcast_busy.test_and_set(std::memory_order_acquire)) {
+            m_broadcast_busy.wait(true, std::memory_order_relaxed);
+        }
+    }
+
+    void release_broadcast_region() {
+        m_broadcast_busy.clear(std::memory_order_release);
+        m_broadcast_busy.notify_all();
+    }
+
+    // publish a task in the acquired broadcast region
+    // return the generation of the region
+    uint32_t publish_broadcast_region(bool is_static, uint32_t size, task_func func, std::latch& latch) {
+        m_broadcast_func = func;
+        m_broadcast_latch = &latch;
+        m_broadcast_pickups.store(size, std::memory_order_relaxed);
+
+        broadcast_state bs;
+        bs.gen = broadcast_state::unpack(m_broadcast_state.load(std::memory_order_relaxed)).gen + 1;
+        bs.is_static = is_static;
+        bs.size = size;
+        m_broadcast_state.store(bs.pack(), std::memory_order_seq_cst);
+
+        if (m_num_sleeping.load(std::memory_order_seq_cst)) {
+            wake_up_subtree(wake_up_root, size);
         }
 
-        std::lock_guard lock(m_dynamic_task_mutex);
+        return bs.gen;
+    }
+
+    // sleeping workers are woken up for broadcast regions in a tree with scaling_opts::wake_up_fanout children per node
+    // the caller wakes up the first workers and each of them wakes up its children, so that waking up the pool takes
+    // time proportional to the logarithm of its size instead of the size
+    // the children of worker i are [(i + 1) * fanout, (i + 2) * fanout)
+    // the caller is the root of the tree
+    static constexpr uint32_t wake_up_root = ~uint32_t(0);
+
+    // wake up the sleeping children of a node in the wake-up tree of a broadcast region with size jobs
+    // woken up children wake up their own children, but awake ones may be busy with other work, so their
+    // children are woken up here
+    void wake_up_subtree(uint32_t node, uint32_t size) {
+        const uint32_t fanout = m_scaling.wake_up_fanout;
+        const uint32_t first = (node + 1) * fanout;
+        const uint32_t last = std::min(first + fanout, size);
+        for (uint32_t i = first; i < last; ++i) {
+            if (!m_workers[i]->wake_up_to_wake_children()) {
+                wake_up_subtree(i, size);
+            }
+        }
+    }
+
+    // called by workers which have been woken up with wake_up_to_wake_children
+    void wake_up_children(uint32_t index) {
+        const auto bs = broadcast_state::unpack(m_broadcast_state.load(std::memory_order_acquire));
+        wake_up_subtree(index, bs.size);
+    }
 
+    worker_task pick_up_broadcast_task(uint32_t index) {
+        worker_task wt{index, m_broadcast_func, m_broadcast_latch};
+        if (m_broadcast_pickups.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            // last pickup, the descriptor is free for the next region
+            release_broadcast_region();
+        }
+        return wt;
+    }
+
+    // claim the next job of a dynamic broadcast region of a given generation
+    std::optional<worker_task> claim_broadcast_task(uint32_t gen) {
+        auto raw = m_broadcast_state.load(std::memory_order_acquire);
         while (true) {
-            if (m_pending_dynamic_tasks.empty()) {
-                m_have_dynamic_tasks.clear(std::memory_order_release);
+            auto bs = broadcast_state::unpack(raw);
+            if (bs.gen != gen || bs.is_static || bs.claimed == bs.size) {
                 return std::nullopt;
             }
+            ++bs.claimed;
+            if (m_broadcast_state.compare_exchange_weak(raw, bs.pack(), std::memory_order_acq_rel)) {
+                return pick_up_broadcast_task(bs.claimed);
+            }
+        }
+    }
 
-            auto& front = m_pending_dynamic_tasks.front();
+    // seen_gen is the last static generation seen by the worker
+    std::optional<worker_task> get_broadcast_task(uint32_t& seen_gen, uint32_t worker_index) {
+        auto bs = broadcast_state::unpack(m_broadcast_state.load(std::memory_order_acquire));
+        if (!bs.is_static) {
+            return claim_broadcast_task(bs.gen);
+        }
+        if (bs.gen == seen_gen) {
+            return std::nullopt;
+        }
+        seen_gen = bs.gen;
+        if (worker_index >= bs.size) {
+            return std::nullopt;
+        }
+        return pick_up_broadcast_task(worker_index + 1);
+    }
+
+    bool have_broadcast_task(uint32_t seen_gen, uint32_t worker_index) const {
+        auto bs = broadcast_state::unpack(m_broadcast_state.load(std::memory_order_seq_cst));
+        if (bs.is_static) {
+            return bs.gen != seen_gen && worker_index < bs.size;
+        }
+        return bs.claimed < bs.size;
+    }
+
+    struct alignas(cpu::alignment_to_avoid_false_sharing) submission_shard {
+        std::mutex mutex;
+
+        // one list per priority class
+        struct region_list {
+            pending_region* head = nullptr;
+            pending_region* tail = nullptr;
+            std::atomic_uint32_t size = 0; // read without locking to skip empty lists
+        };
+        region_list lists[num_priority_classes];
+    };
+    submission_shard m_shards[num_submission_shards];
+
+    void link_pending_region(pending_region& r) {
+        auto& shard = m_shards[r.shard];
+        std::lock_guard lock(shard.mutex);
+        auto& list = shard.lists[r.priority];
+        r.prev = list.tail;
+        if (list.tail) {
+            list.tail->next = &r;
+        }
+        else {
+            list.head = &r;
+        }
+        list.tail = &r;
+        r.linked = true;
+        list.size.fetch_add(1, std::memory_order_relaxed);
+        m_num_pending_regions[r.priority].fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    // must be called with the shard mutex locked
+    void unlink_pending_region_locked(pending_region& r) {
+        if (!r.linked) return;
+        auto& list = m_shards[r.shard].lists[r.priority];
+        (r.prev ? r.prev->next : list.head) = r.next;
+        (r.next ? r.next->prev : list.tail) = r.prev;
+        r.prev = r.next = nullptr;
+        r.linked = false;
+        list.size.fetch_sub(1, std::memory_order_relaxed);
+        m_num_pending_regions[r.priority].fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void unlink_pending_region(pending_region& r) {
+        std::lock_guard lock(m_shards[r.shard].mutex);
+        unlink_pending_region_locked(r);
+    }
+
+    // get the next pending job, higher priority classes first
+    std::optional<worker_task> get_pending_dynamic_task(priority_class lowest = priority_background) {
+        for (uint32_t p = 0; p <= lowest; ++p) {
+            if (!m_num_pending_regions[p].load(std::memory_order_acquire)) {
+                continue;
+            }
+
+            for (uint32_t i = 0; i < num_submission_shards; ++i) {
+                auto& shard = m_shards[(shard_hint + i) % num_submission_shards];
+                auto& list = shard.lists[p];
+                if (!list.size.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+
+                // claim under the lock, so that the owner doesn't return while we access the region
+                std::lock_guard lock(shard.mutex);
+                while (auto r = list.head) {
+                    if (auto t = r->claim()) {
+                        return t;
+                    }
+                    // exhausted
+                    unlink_pending_region_locked(*r);
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    // used by background jobs to check whether they should yield
+    bool have_higher_priority_work(priority_class prio) const {
+        if (prio == priority_high) return false;
+        if (have_pending_dynamic_tasks(priority_class(prio - 1), std::memory_order_relaxed)) return true;
+        // broadcast regions are never background
+        return prio == priority_background && m_broadcast_busy.test(std::memory_order_relaxed);
+    }
+
+    // federation
+    // set once when the pool joins a federation, the limits are set before it
+    std::atomic<federation::impl*> m_federation = nullptr;
+    uint32_t m_max_lent_workers = 0;
+    uint32_t m_max_borrowed_jobs = 0;
+
+    // number of workers of this pool running jobs of other pools
+    std::atomic_uint32_t m_num_lent_workers = 0;
+
+    // number of jobs of this pool running on workers of other pools
+    std::atomic_uint32_t m_num_borrowed_jobs = 0;
+
+    // set when a search for federated work skipped the jobs of this pool because of m_max_borrowed_jobs
+    // the federation is notified again when a borrowed job finishes
+    std::atomic_bool m_federation_skipped = false;
+
+    bool have_unclaimed_jobs() const {
+        const auto bs = broadcast_state::unpack(m_broadcast_state.load(std::memory_order_acquire));
+        return (!bs.is_static && bs.claimed < bs.size)
+            || have_pending_dynamic_tasks(priority_background, std::memory_order_acquire);
+    }
+
+    struct borrowed_task {
+        worker_task task;
+        impl* owner;
+    };
+
+    bool have_federated_work() const {
+        auto fed = m_federation.load(std::memory_order_acquire);
+        return fed
+            && fed->m_have_pending.test(std::memory_order_seq_cst)
+            && m_num_lent_workers.load(std::memory_order_relaxed) < m_max_lent_workers;
+    }
 
-            if (!front.done()) {
-                return front.get_next_worker_task();
+    // called by idle workers of this pool
+    std::optional<borrowed_task> borrow_federated_task() {
+        auto fed = m_federation.load(std::memory_order_acquire);
+        if (!fed || !fed->m_have_pending.test(std::memory_order_relaxed)) return std::nullopt;
+        if (!try_increment(m_num_lent_workers, m_max_lent_workers)) return std::nullopt;
+
+        // clear before searching, so that members which queue jobs in the meantime set it again
+        fed->m_have_pending.clear(std::memory_order_seq_cst);
+        {
+            std::shared_lock lock(fed->m_mutex);
+            for (auto* owner : fed->m_members) {
+                if (owner == this) continue;
+                const auto bs = broadcast_state::unpack(owner->m_broadcast_state.load(std::memory_order_acquire));
+                const bool have_broadcast_jobs = !bs.is_static && bs.claimed < bs.size;
+                if (!have_broadcast_jobs
+                    && !owner->have_pending_dynamic_tasks(priority_background, std::memory_order_acquire)
+                ) {
+                    continue;
+                }
+                if (!try_increment(owner->m_num_borrowed_jobs, owner->m_max_borrowed_jobs)) {
+                    owner->m_federation_skipped.store(true, std::memory_order_seq_cst);
+                    // a borrowed job may have finished in the meantime without seeing the flag
+                    if (owner->m_num_borrowed_jobs.load(std::memory_order_seq_cst) >= owner->m_max_borrowed_jobs
+                        || !try_increment(owner->m_num_borrowed_jobs, owner->m_max_borrowed_jobs)
+                    ) {
+                        continue;
+                    }
+                }
+                auto t = have_broadcast_jobs ? owner->claim_broadcast_task(bs.gen) : std::nullopt;
+                if (!t) {
+                    t = owner->get_pending_dynamic_task();
+                }
+                if (t) {
+                    // there may be more
+                    fed->m_have_pending.test_and_set(std::memory_order_relaxed);
+                    return borrowed_task{*t, owner};
+                }
+                owner->m_num_borrowed_jobs.fetch_sub(1, std::memory_order_relaxed);
             }
+        }
+        m_num_lent_workers.fetch_sub(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
 
-            m_pending_dynamic_tasks.pop_front();
+    void run_borrowed_task(const borrowed_task& bt) {
+        // the thread is a worker of both pools while running the task
+        current_pool = bt.owner;
+        lender_pool = this;
+        {
+            region_scope region;
+            scratch_arena::scope scratch;
+            bt.task.func(bt.task.index);
+        }
+        lender_pool = nullptr;
+        current_pool = this;
+
+        bt.owner->m_num_borrowed_jobs.fetch_sub(1, std::memory_order_seq_cst);
+        m_num_lent_workers.fetch_sub(1, std::memory_order_relaxed);
+
+        // the pending flag of the federation was cleared by searches which skipped the owner at its limit
+        if (bt.owner->m_federation_skipped.exchange(false, std::memory_order_seq_cst)
+            && bt.owner->have_unclaimed_jobs()
+        ) {
+            bt.owner->notify_federation(1);
+        }
+
+        // the owner may be destroyed as soon as its task is done
+        bt.task.latch->count_down();
+    }
+
+    // called after queuing jobs which no worker of this pool could take
+    void notify_federation(uint32_t num_jobs) {
+        auto fed = m_federation.load(std::memory_order_acquire);
+        if (!fed) return;
+        if (m_num_borrowed_jobs.load(std::memory_order_relaxed) >= m_max_borrowed_jobs) return;
+
+        fed->m_have_pending.test_and_set(std::memory_order_seq_cst);
+
+        std::shared_lock lock(fed->m_mutex);
+        for (auto* other : fed->m_members) {
+            if (other == this) continue;
+            const auto n = other->num_threads();
+            for (uint32_t i = 0; i < n && num_jobs; ++i) {
+                if (other->m_workers[i]->wake_up_if_sleeping()) {
+                    --num_jobs;
+                }
+            }
+            if (!num_jobs) break;
+        }
+    }
+
+    // task groups (see task_group.hpp)
+
+    struct spawned_task {
+        task_group::task func;
+        task_group* group;
+    };
+
+    // tasks spawned by a thread, which pops them from the back, while others steal them from the front
+    struct alignas(cpu::alignment_to_avoid_false_sharing) spawned_deque {
+        std::mutex mutex;
+        std::deque<spawned_task> tasks;
+        std::atomic_uint32_t size = 0; // read without locking to skip empty deques
+    };
+
+    // deques of threads which are not workers of the pool, shared like the submission shards
+    spawned_deque m_external_spawned[num_submission_shards];
+
+    // number of queued spawned tasks in all deques
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_uint32_t m_num_spawned = 0;
+
+    // threads waiting for a group with no tasks to help with sleep on this
+    // it changes when a group finishes and, if there are waiters, when a task is spawned
+    alignas(cpu::alignment_to_avoid_false_sharing) std::atomic_uint32_t m_spawn_events = 0;
+    std::atomic_uint32_t m_num_spawn_waiters = 0;
+
+    bool have_spawned_tasks(std::memory_order order) const {
+        return !!m_num_spawned.load(order);
+    }
+
+    // deques of workers come first, then external ones
+    uint32_t num_spawned_deques() const {
+        return uint32_t(m_workers.size()) + num_submission_shards;
+    }
+
+    spawned_deque& get_spawned_deque(uint32_t i) {
+        return i < m_workers.size() ? m_workers[i]->m_spawned : m_external_spawned[i - m_workers.size()];
+    }
+
+    uint32_t own_spawned_deque_index() const {
+        if (auto wi = current_worker_index()) return *wi;
+        return uint32_t(m_workers.size()) + shard_hint % num_submission_shards;
+    }
+
+    void notify_spawn_waiters() {
+        m_spawn_events.fetch_add(1, std::memory_order_seq_cst);
+        m_spawn_events.notify_all();
+    }
+
+    void spawn(task_group& g, task_group::task func) {
+        g.m_num_pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            auto& d = get_spawned_deque(own_spawned_deque_index());
+            std::lock_guard lock(d.mutex);
+            d.tasks.push_back({std::move(func), &g});
+            d.size.fetch_add(1, std::memory_order_relaxed);
+            m_num_spawned.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        if (m_num_spawn_waiters.load(std::memory_order_seq_cst)) {
+            notify_spawn_waiters();
+        }
+
+        if (m_num_sleeping.load(std::memory_order_seq_cst)) {
+            const auto n = num_threads();
+            for (uint32_t i = 0; i < n; ++i) {
+                if (m_workers[i]->wake_up_if_sleeping()) break;
+            }
+        }
+        else if (m_num_lazy_threads.load(std::memory_order_relaxed)) {
+            start_lazy_workers(num_threads() + 1, false);
+        }
+    }
+
+    std::optional<spawned_task> pop_spawned_task(spawned_deque& d, bool back) {
+        if (!d.size.load(std::memory_order_acquire)) return std::nullopt;
+        std::lock_guard lock(d.mutex);
+        if (d.tasks.empty()) return std::nullopt;
+        std::optional<spawned_task> ret(std::move(back ? d.tasks.back() : d.tasks.front()));
+        if (back) {
+            d.tasks.pop_back();
+        }
+        else {
+            d.tasks.pop_front();
+        }
+        d.size.fetch_sub(1, std::memory_order_relaxed);
+        m_num_spawned.fetch_sub(1, std::memory_order_relaxed);
+        return ret;
+    }
+
+    // the newest task of the current thread, or the oldest one of another thread
+    std::optional<spawned_task> take_spawned_task() {
+        if (!have_spawned_tasks(std::memory_order_acquire)) return std::nullopt;
+        const auto own = own_spawned_deque_index();
+        if (auto t = pop_spawned_task(get_spawned_deque(own), true)) return t;
+        const auto n = num_spawned_deques();
+        for (uint32_t i = 1; i < n; ++i) {
+            if (auto t = pop_spawned_task(get_spawned_deque((own + i) % n), false)) return t;
+        }
+        return std::nullopt;
+    }
+
+    void run_spawned_task(spawned_task& t) {
+        auto& g = *t.group;
+        {
+            region_scope region;
+            scratch_arena::scope scratch;
+            try {
+                t.func();
+            }
+            catch (...) {
+                // the thread may be waiting for another group (or be a worker), so keep it for the wait() of this one
+                if (!g.m_failed.test_and_set(std::memory_order_relaxed)) {
+                    g.m_exception = std::current_exception();
+                }
+            }
+        }
+
+        // the captures of the callable may refer to the group, so destroy it before the group is done
+        t.func.reset();
+        if (g.m_num_pending.fetch_sub(1, std::memory_order_seq_cst) == 1
+            && m_num_spawn_waiters.load(std::memory_order_seq_cst)
+        ) {
+            // the group may be destroyed from now on, only the pool is touched
+            notify_spawn_waiters();
+        }
+    }
+
+    void wait_for_group(task_group& g) {
+        region_scope caller_region;
+        while (g.m_num_pending.load(std::memory_order_acquire)) {
+            if (auto t = take_spawned_task()) {
+                run_spawned_task(*t);
+                continue;
+            }
+
+            // the remaining tasks of the group are running on other threads
+            // wait until they finish, or until one of them spawns a task to help with
+            bool done = false;
+            for (uint32_t i = 0; i < idle_spin_count; ++i) {
+                done = !g.m_num_pending.load(std::memory_order_acquire);
+                if (done || have_spawned_tasks(std::memory_order_relaxed)) break;
+                cpu::relax();
+            }
+            if (done) break;
+
+            m_num_spawn_waiters.fetch_add(1, std::memory_order_seq_cst);
+            const auto e = m_spawn_events.load(std::memory_order_seq_cst);
+            if (g.m_num_pending.load(std::memory_order_seq_cst) && !have_spawned_tasks(std::memory_order_seq_cst)) {
+                m_spawn_events.wait(e, std::memory_order_seq_cst);
+            }
+            m_num_spawn_waiters.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 
@@ -141,6 +747,25 @@ struct thread_pool::impl {
 
         std::atomic_flag m_busy = ATOMIC_FLAG_INIT;
 
+        std::atomic_bool m_sleeping = false;
+
+        // not running or about to stop, guarded by m_mutex
+        // tasks are not added to retired workers
+        bool m_retired = true;
+
+        uint32_t m_broadcast_gen = 0; // last seen static broadcast generation
+
+        // set when woken up for a broadcast region, guarded by m_mutex
+        bool m_wake_children = false;
+
+        std::optional<borrowed_task> m_borrowed_task; // job of another pool in the federation
+
+        spawned_deque m_spawned; // tasks of task groups spawned by this worker
+        std::optional<spawned_task> m_spawned_task; // the task being run
+
+        // allocated and used only by the worker thread
+        scratch_arena m_scratch;
+
         explicit worker(uint32_t i, impl& pool
             #if PAR_DEBUG_STATS
             , debug_stats::worker_stats& ds
@@ -151,12 +776,46 @@ struct thread_pool::impl {
             #if PAR_DEBUG_STATS
             , m_debug_stats(ds)
             #endif
-        {
+        {}
+
+        ~worker() {
+            if (m_thread.joinable()) {
+                m_thread.join();
+            }
+        }
+
+        // (re)start the thread of a worker
+        // the worker must be retired
+        void start(uint32_t broadcast_gen) {
+            if (m_thread.joinable()) {
+                // retired by itself, but not joined
+                m_thread.join();
+            }
+            {
+                std::lock_guard lock(m_mutex);
+                m_retired = false;
+                m_pending_tasks.clear();
+                m_executing_tasks.clear();
+                m_busy.clear();
+                m_sleeping = false;
+                m_broadcast_gen = broadcast_gen;
+                m_wake_children = false;
+                m_borrowed_task.reset();
+                m_spawned_task.reset();
+            }
             m_thread = std::thread(&worker::run, this);
         }
 
-        ~worker() {
-            m_thread.join();
+        // stop the worker after it finishes its current tasks
+        void retire() {
+            {
+                std::unique_lock lock(m_mutex);
+                if (m_retired) return;
+                m_retired = true;
+                m_busy.test_and_set(std::memory_order_acquire);
+                m_pending_tasks.push_back({});
+            }
+            m_cv.notify_one();
         }
 
         worker(const worker&) = delete;
@@ -183,7 +842,7 @@ struct thread_pool::impl {
             }
             {
                 std::unique_lock lock(m_mutex);
-                if (m_busy.test_and_set(std::memory_order_acquire)) {
+                if (m_retired || m_busy.test_and_set(std::memory_order_acquire)) {
                     return false;
                 }
                 m_pending_tasks.push_back(task);
@@ -200,8 +859,59 @@ struct thread_pool::impl {
             return true;
         }
 
+        bool wake_up_if_sleeping() {
+            if (!m_sleeping.load(std::memory_order_seq_cst)) return false;
+            {
+                // make sure the worker is waiting and not between its last check and the wait
+                std::lock_guard lock(m_mutex);
+            }
+            m_cv.notify_one();
+            return true;
+        }
+
+        // wake up the worker if it's sleeping and make it wake up its children in the wake-up tree
+        // return false if it's awake, in which case the children are up to the caller
+        bool wake_up_to_wake_children() {
+            if (!m_sleeping.load(std::memory_order_seq_cst)) return false;
+            {
+                // m_sleeping is cleared with m_mutex locked, so if it's still set, the worker is waiting and will
+                // see m_wake_children when it wakes up
+                std::lock_guard lock(m_mutex);
+                if (!m_sleeping.load(std::memory_order_relaxed)) return false;
+                m_wake_children = true;
+            }
+            m_cv.notify_one();
+            return true;
+        }
+
+        // must be called with m_mutex locked
+        bool have_work() const {
+            return !m_pending_tasks.empty()
+                || m_busy.test(std::memory_order_seq_cst)
+                || m_pool.have_broadcast_task(m_broadcast_gen, m_index)
+                || m_pool.have_pending_dynamic_tasks(priority_background, std::memory_order_seq_cst)
+                || m_pool.have_spawned_tasks(std::memory_order_seq_cst)
+                || m_pool.have_federated_work();
+        }
+
+        void spin_while_idle() const {
+            for (uint32_t i = 0; i < idle_spin_count; ++i) {
+                if (m_busy.test(std::memory_order_relaxed)
+                    || m_pool.have_broadcast_task(m_broadcast_gen, m_index)
+                    || m_pool.have_pending_dynamic_tasks(priority_background, std::memory_order_relaxed)
+                    || m_pool.have_spawned_tasks(std::memory_order_relaxed)
+                    || m_pool.have_federated_work()
+                ) {
+                    return;
+                }
+                cpu::relax();
+            }
+        }
+
         void run() {
             current_pool = &m_pool;
+            worker_scratch = &m_scratch;
+            worker_index = m_index;
             #if PAR_DEBUG_STATS
             impl::current_worker = this;
             #endif
@@ -210,6 +920,7 @@ struct thread_pool::impl {
                 this_thread::set_name(name);
             }
 
+            bool retired_by_self = false;
             while (true) {
                 std::unique_lock lock(m_mutex);
                 while (true) {
@@ -218,7 +929,18 @@ struct thread_pool::impl {
                         lock.unlock();
                         break;
                     }
-                    if (auto t = m_pool.get_pending_dynamic_task()) {
+                    // high priority dynamic tasks come before anything else
+                    auto t = m_pool.get_pending_dynamic_task(priority_high);
+                    if (!t) {
+                        if (auto bt = m_pool.get_broadcast_task(m_broadcast_gen, m_index)) {
+                            m_busy.test_and_set(std::memory_order_acquire);
+                            m_executing_tasks.push_back(*bt);
+                            lock.unlock();
+                            break;
+                        }
+                        t = m_pool.get_pending_dynamic_task();
+                    }
+                    if (t) {
                         // check for dynamic tasks
                         m_busy.test_and_set(std::memory_order_acquire);
                         m_executing_tasks.push_back(*t);
@@ -228,10 +950,81 @@ struct thread_pool::impl {
                         #endif
                         break;
                     }
+                    if (auto st = m_pool.take_spawned_task()) {
+                        m_busy.test_and_set(std::memory_order_acquire);
+                        m_spawned_task.emplace(std::move(*st));
+                        lock.unlock();
+                        break;
+                    }
+                    if (m_pool.have_federated_work()) {
+                        // don't hold our mutex while locking the federation, as notify_federation locks them in
+                        // the opposite order
+                        lock.unlock();
+                        m_borrowed_task = m_pool.borrow_federated_task();
+                        if (m_borrowed_task) {
+                            m_busy.test_and_set(std::memory_order_acquire);
+                            break;
+                        }
+                        lock.lock();
+                        continue; // new tasks may have arrived in the meantime
+                    }
                     m_busy.clear(std::memory_order_release);
 
-                    m_cv.wait(lock);
+                    lock.unlock();
+                    spin_while_idle();
+                    lock.lock();
+
+                    m_sleeping.store(true, std::memory_order_seq_cst);
+                    ++m_pool.m_num_sleeping;
+                    if (!have_work()) {
+                        if (m_pool.may_retire(m_index)) {
+                            if (m_cv.wait_for(lock, m_pool.m_scaling.idle_timeout) == std::cv_status::timeout
+                                && !have_work()
+                            ) {
+                                retired_by_self = m_pool.try_retire(m_index);
+                            }
+                        }
+                        else {
+                            m_cv.wait(lock);
+                        }
+                    }
+                    --m_pool.m_num_sleeping;
+                    m_sleeping.store(false, std::memory_order_relaxed);
+
+                    if (m_wake_children) {
+                        // before picking up our own job, so that the rest of the tree wakes up in parallel
+                        m_wake_children = false;
+                        lock.unlock();
+                        m_pool.wake_up_children(m_index);
+                        lock.lock();
+                    }
+
+                    if (retired_by_self) {
+                        m_retired = true;
+                        break;
+                    }
+                }
+                if (retired_by_self) break;
+
+                if (m_spawned_task) {
+                    m_pool.run_spawned_task(*m_spawned_task);
+                    m_spawned_task.reset();
+                    #if PAR_DEBUG_STATS
+                    ++m_debug_stats.num_tasks_executed;
+                    #endif
+                    continue;
+                }
+
+                if (m_borrowed_task) {
+                    m_pool.run_borrowed_task(*m_borrowed_task);
+                    m_borrowed_task.reset();
+                    #if PAR_DEBUG_STATS
+                    ++m_debug_stats.num_tasks_stolen;
+                    ++m_debug_stats.num_tasks_executed;
+                    #endif
+                    continue;
                 }
+
                 #if PAR_DEBUG_STATS
                 auto start = high_res_clock::now();
                 #endif
@@ -251,39 +1044,79 @@ struct thread_pool::impl {
                 #endif
                 m_executing_tasks.clear();
             }
+
+            // the previous worker is now the last one and may retire, too
+            if (m_index > 0) {
+                m_pool.m_workers[m_index - 1]->wake_up_if_sleeping();
+            }
         }
     };
 
     std::vector<anchor<worker>> m_workers;
 
-    impl(std::string name, uint32_t nthreads, [[maybe_unused]] debug_stats* ds)
+    impl(std::string name, uint32_t nthreads, const scaling_opts& scaling, [[maybe_unused]] debug_stats* ds)
         : m_name(std::move(name))
+        , m_scaling(scaling)
         #if PAR_DEBUG_STATS
         , m_own_debug_stats()
         , m_debug_stats(ds ? *ds : m_own_debug_stats)
         , m_caller_stats(m_debug_stats.caller_stats)
         #endif
     {
+        if (m_scaling.max_threads == 0) {
+            // not specified
+            m_scaling.max_threads = std::max(nthreads, m_scaling.min_threads);
+        }
+        const uint32_t max_threads = m_scaling.max_threads;
+        if (max_threads > thread_pool::max_threads_limit) {
+            throw std::runtime_error("too many par::thread_pool threads");
+        }
+        nthreads = std::min(std::max(nthreads, m_scaling.min_threads), max_threads);
+        if (m_scaling.wake_up_fanout == 0 || m_scaling.wake_up_fanout > max_threads) {
+            // a single level: the caller wakes up all workers
+            m_scaling.wake_up_fanout = std::max(max_threads, 1u);
+        }
+
         #if PAR_DEBUG_STATS
         m_debug_stats.pool_name = m_name;
-        m_debug_stats.per_worker.resize(nthreads);
+        m_debug_stats.per_worker.resize(max_threads);
         m_debug_stats.total_lifetime_ns = high_res_clock::now().time_since_epoch().count();
         #endif
 
-        m_workers.reserve(nthreads);
-        for (uint32_t i = 0; i < nthreads; ++i) {
+        m_workers.reserve(max_threads);
+        for (uint32_t i = 0; i < max_threads; ++i) {
             m_workers.emplace_back(i, *this
                 #if PAR_DEBUG_STATS
                 , *m_debug_stats.per_worker[i]
                 #endif
             );
         }
+
+        if (m_scaling.lazy) {
+            m_num_lazy_threads.store(nthreads, std::memory_order_release);
+        }
+        else {
+            m_num_threads.store(nthreads, std::memory_order_release);
+            start_workers(0, nthreads);
+        }
     }
 
     ~impl() {
+        wait_for_async_regions();
+
+        if (auto fed = m_federation.load(std::memory_order_relaxed)) {
+            std::unique_lock lock(fed->m_mutex);
+            std::erase(fed->m_members, this);
+        }
+
         for (auto& worker : m_workers) {
             // notify workers to stop
-            worker->add_task({});
+            worker->retire();
+        }
+        for (auto& worker : m_workers) {
+            if (worker->m_thread.joinable()) {
+                worker->m_thread.join();
+            }
         }
         #if PAR_DEBUG_STATS
         auto lifetime = high_res_clock::now().time_since_epoch().count() - m_debug_stats.total_lifetime_ns;
@@ -294,17 +1127,192 @@ struct thread_pool::impl {
     }
 
     bool current_thread_is_worker() const {
-        return current_pool == this;
+        return current_pool == this || lender_pool == this;
+    }
+
+    std::optional<uint32_t> current_worker_index() const {
+        // lent workers are running a job of current_pool, but belong to lender_pool
+        const auto own_pool = lender_pool ? lender_pool : current_pool;
+        if (own_pool != this) return std::nullopt;
+        return worker_index;
+    }
+
+    uint32_t num_threads() const {
+        return m_num_threads.load(std::memory_order_relaxed);
+    }
+
+    // the size of the pool including lazy workers which haven't been started yet
+    uint32_t num_planned_threads() const {
+        return num_threads() + m_num_lazy_threads.load(std::memory_order_relaxed);
+    }
+
+    // resizing
+
+    // start workers in [begin, end)
+    // the broadcast region must be acquired (or no tasks must be running)
+    // m_num_threads must already include them, so that the last one knows it may retire
+    void start_workers(uint32_t begin, uint32_t end) {
+        const auto gen = broadcast_state::unpack(m_broadcast_state.load(std::memory_order_relaxed)).gen;
+        for (uint32_t i = begin; i < end; ++i) {
+            m_workers[i]->start(gen);
+        }
+    }
+
+    void resize(uint32_t nthreads) {
+        if (nthreads > m_workers.size()) {
+            throw std::runtime_error("par::thread_pool resize beyond max_threads");
+        }
+        if (current_thread_is_worker()) {
+            // a worker may retire itself and join its own thread, or wait for the region it's running
+            throw std::runtime_error("par::thread_pool resize from a worker");
+        }
+
+        {
+            std::lock_guard lock(m_resize_mutex);
+            resize_locked(nthreads);
+        }
+        start_wanted_lazy_workers();
+    }
+
+    // called with m_resize_mutex locked
+    void resize_locked(uint32_t nthreads) {
+        acquire_broadcast_region();
+        const auto cur = num_threads();
+        if (m_scaling.lazy && nthreads > cur) {
+            // the new workers are started on demand
+            m_num_lazy_threads.store(nthreads - cur, std::memory_order_relaxed);
+            release_broadcast_region();
+            return;
+        }
+        m_num_lazy_threads.store(0, std::memory_order_relaxed);
+        m_num_threads.store(nthreads, std::memory_order_seq_cst);
+        if (nthreads > cur) {
+            start_workers(cur, nthreads);
+        }
+        for (uint32_t i = nthreads; i < cur; ++i) {
+            // tasks which were added to the worker before this are still executed
+            m_workers[i]->retire();
+        }
+        release_broadcast_region();
+
+        // join retired workers, including ones which retired by themselves
+        for (uint32_t i = nthreads; i < m_workers.size(); ++i) {
+            auto& t = m_workers[i]->m_thread;
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+    }
+
+    // auto-scaling: grow when there are more jobs than idle workers
+    void try_grow(uint32_t num_jobs) {
+        std::unique_lock lock(m_resize_mutex, std::try_to_lock);
+        if (!lock) return; // someone else is resizing
+        if (!try_acquire_broadcast_region()) return; // don't wait on other regions
+
+        const auto cur = num_threads();
+        const auto nthreads = std::min(cur + num_jobs, m_scaling.max_threads);
+        m_num_threads.store(nthreads, std::memory_order_seq_cst);
+        start_workers(cur, nthreads);
+
+        // the new workers count towards the lazy ones
+        const auto lazy = m_num_lazy_threads.load(std::memory_order_relaxed);
+        m_num_lazy_threads.store(lazy - std::min(lazy, nthreads - cur), std::memory_order_relaxed);
+
+        release_broadcast_region();
+        lock.unlock();
+        start_wanted_lazy_workers();
+    }
+
+    // start lazy workers until at least `needed` are running (or there are no more lazy ones)
+    // workers of the pool must not wait, as the resize or region they would wait for may be waiting for them
+    // neither must callers of run_task_async
+    // if the pool is busy, a caller which doesn't wait leaves the workers to whoever is resizing it (see
+    // start_wanted_lazy_workers), and a busy broadcast region means there are running workers to pick up its jobs
+    void start_lazy_workers(uint32_t needed, bool wait) {
+        if (!wait) {
+            // before trying the lock, so that the holder sees it after releasing it
+            raise_to(m_num_wanted_lazy_threads, needed);
+        }
+
+        {
+            std::unique_lock lock(m_resize_mutex, std::defer_lock);
+            if (wait) {
+                lock.lock();
+                acquire_broadcast_region();
+            }
+            else {
+                if (!lock.try_lock()) return;
+                if (!try_acquire_broadcast_region()) return;
+            }
+            needed = std::max(needed, m_num_wanted_lazy_threads.exchange(0, std::memory_order_seq_cst));
+
+            const auto cur = num_threads();
+            const auto lazy = m_num_lazy_threads.load(std::memory_order_relaxed);
+            const auto nthreads = std::min(std::max(needed, cur), cur + lazy);
+            if (nthreads > cur) {
+                m_num_lazy_threads.store(lazy - (nthreads - cur), std::memory_order_relaxed);
+                m_num_threads.store(nthreads, std::memory_order_seq_cst);
+                start_workers(cur, nthreads);
+            }
+
+            release_broadcast_region();
+        }
+
+        start_wanted_lazy_workers();
+    }
+
+    // called after releasing m_resize_mutex
+    void start_wanted_lazy_workers() {
+        if (m_num_wanted_lazy_threads.load(std::memory_order_seq_cst)) {
+            start_lazy_workers(0, false);
+        }
+    }
+
+    // auto-scaling: only the last worker retires, so that the running workers are always [0, num_threads)
+    bool may_retire(uint32_t index) const {
+        const auto cur = m_num_threads.load(std::memory_order_seq_cst);
+        return m_scaling.auto_scale && index + 1 == cur && cur > m_scaling.min_threads;
+    }
+
+    // called by an idle worker after idle_timeout
+    bool try_retire(uint32_t index) {
+        std::unique_lock lock(m_resize_mutex, std::try_to_lock);
+        if (!lock) return false;
+        if (!try_acquire_broadcast_region()) return false;
+        const bool ret = may_retire(index);
+        if (ret) {
+            m_num_threads.store(index, std::memory_order_seq_cst);
+        }
+        release_broadcast_region();
+        lock.unlock();
+        if (!ret) {
+            // a retiring worker can't start others, as it could be asked to join its own thread
+            start_wanted_lazy_workers();
+        }
+        return ret;
     }
 
     uint32_t get_par(const run_opts& opts) const {
-        const auto num_workers = uint32_t(m_workers.size());
+        return get_par(opts, num_planned_threads());
+    }
+
+    // opts.max_par may have been adjusted by adjust_par before the pool shrunk
+    // honor it as long as it's within the capacity of the pool
+    // other values are clamped to the current number of workers
+    uint32_t get_planned_par(const run_opts& opts) const {
+        if (!opts.max_par_adjusted) return get_par(opts);
+        return get_par(opts, uint32_t(m_workers.size()));
+    }
+
+    uint32_t get_par(const run_opts& opts, uint32_t num_workers) const {
         if (num_workers == 0) return 1; // no workers, only caller thread
 
         if (current_thread_is_worker()) {
             switch (opts.sched) {
             // allow nesting, but don't oversubscribe
-            case schedule_dynamic: return 1 + std::min(opts.max_par - 1, uint32_t(m_workers.size() - 1));
+            case schedule_affinity: [[fallthrough]];
+            case schedule_dynamic: return 1 + std::min(opts.max_par - 1, num_workers - 1);
 
             // no extra workers
             case schedule_dynamic_no_nesting: return 1;
@@ -316,15 +1324,17 @@ struct thread_pool::impl {
             }
         }
         else {
-            return 1 + std::min(opts.max_par - 1, uint32_t(m_workers.size()));
+            return 1 + std::min(opts.max_par - 1, num_workers);
         }
     }
 
     uint32_t run_task(const run_opts& opts, task_func func) {
-        auto num_worker_jobs = get_par(opts);
+        region_scope caller_region;
+        auto num_worker_jobs = get_planned_par(opts);
 
         if (num_worker_jobs == 1) {
             // only run in the caller thread
+            scratch_arena::scope scratch;
             func(0);
             return 1;
         }
@@ -340,37 +1350,61 @@ struct thread_pool::impl {
         // the caller will do at least one unit of work, so exclude it
         --num_worker_jobs;
 
+        if (num_worker_jobs > num_threads() && m_num_lazy_threads.load(std::memory_order_relaxed)) {
+            start_lazy_workers(num_worker_jobs, !current_thread_is_worker());
+        }
+
         std::latch latch(num_worker_jobs);
 
-        bool task_added_to_dynamic_tasks = false;
+        std::optional<pending_region> region;
+        std::optional<uint32_t> dynamic_broadcast_gen;
+        uint32_t num_retired_jobs = 0; // run by the caller
         if (opts.sched == schedule_static) {
             // static scheduling, no work stealing
-            // just add task to corresponding workers
-            for (uint32_t i = 0; i < num_worker_jobs; ++i) {
-                m_workers[i]->add_task({ i + 1, func, &latch });
+            // workers pick up their corresponding jobs from the broadcast region
+            acquire_broadcast_region();
+
+            // if the pool has shrunk after the caller planned the task, the caller runs the jobs of the retired
+            // workers after its own
+            const auto num_broadcast_jobs = std::min(num_worker_jobs, num_threads());
+            num_retired_jobs = num_worker_jobs - num_broadcast_jobs;
+
+            if (num_broadcast_jobs) {
+                publish_broadcast_region(true, num_broadcast_jobs, func, latch);
             }
+            else {
+                release_broadcast_region();
+            }
+        }
+        else if (
+            opts.priority != priority_background
+            && num_worker_jobs == num_threads()
+            && try_acquire_broadcast_region()
+        ) {
+            // full-pool dynamic region, idle workers claim jobs from the broadcast region
+            dynamic_broadcast_gen = publish_broadcast_region(false, num_worker_jobs, func, latch);
         }
         else {
+            const auto num_workers = num_threads();
             uint32_t index = 0;
-            for (auto& w : m_workers) {
-                if (w->try_add_task({ index + 1, func, &latch })) {
-                    ++index;
-                    if (index == num_worker_jobs) {
-                        break;
+            if (opts.priority != priority_background) {
+                // background jobs are only queued, so that workers can pick up higher priority ones first
+                for (uint32_t wi = 0; wi < num_workers; ++wi) {
+                    if (m_workers[wi]->try_add_task({ index + 1, func, &latch })) {
+                        ++index;
+                        if (index == num_worker_jobs) {
+                            break;
+                        }
                     }
                 }
             }
             if (index < num_worker_jobs) {
                 // not enough idle workers, add the rest to the pending dynamic tasks
-                task_added_to_dynamic_tasks = true;
-                {
-                    std::lock_guard lock(m_dynamic_task_mutex);
-                    m_pending_dynamic_tasks.emplace_back(index, num_worker_jobs, func, latch);
-                    m_have_dynamic_tasks.test_and_set(std::memory_order_release);
-                }
-                for (auto& w : m_workers) {
+                region.emplace(index, num_worker_jobs, func, latch, opts.priority, shard_hint % num_submission_shards);
+                link_pending_region(*region);
+                for (uint32_t wi = 0; wi < num_workers; ++wi) {
                     // try to wake up workers which have gone idle while we were adding the pending task
-                    if (w->try_wake_up_if_idle()) {
+                    if (m_workers[wi]->try_wake_up_if_idle()) {
                         ++index;
                         if (index == num_worker_jobs) {
                             // we woke up enough workers to do the remote task
@@ -378,44 +1412,200 @@ struct thread_pool::impl {
                         }
                     }
                 }
+                if (index < num_worker_jobs) {
+                    notify_federation(num_worker_jobs - index);
+                }
+                if (index < num_worker_jobs && m_scaling.auto_scale && num_workers < m_scaling.max_threads) {
+                    try_grow(num_worker_jobs - index);
+                }
             }
         }
 
-        func(0);
+        {
+            scratch_arena::scope scratch;
+            func(0);
+        }
         #if PAR_DEBUG_STATS
         ++dstats.num_tasks_executed;
         #endif
 
-        if (opts.sched != schedule_static && task_added_to_dynamic_tasks) {
-            // try stealing work while possible
-            while (true) {
-                worker_task task;
-
-                {
-                    std::lock_guard lock(m_dynamic_task_mutex);
-
-                    // find our task so that the caller only works on its own task
-                    auto f = itlib::pfind_if(m_pending_dynamic_tasks, [&](const pending_dynamic_task& t) {
-                        return &t.latch == &latch;
-                    });
-                    if (!f || f->done()) break; // no more work to steal
-                    task = f->get_next_worker_task();
-
-                    // note that we don't remove the task from m_pending_dynamic_tasks here
-                    // we leave this job to the workers
+        if (dynamic_broadcast_gen) {
+            {
+                // workers of other pools in the federation may help with the jobs which are still unclaimed
+                auto bs = broadcast_state::unpack(m_broadcast_state.load(std::memory_order_relaxed));
+                if (bs.gen == *dynamic_broadcast_gen && bs.claimed < bs.size) {
+                    notify_federation(bs.size - bs.claimed);
                 }
+            }
 
-                task();
+            // claim the jobs which no worker has claimed yet
+            uint32_t num_unclaimed = 0;
+            while (auto task = claim_broadcast_task(*dynamic_broadcast_gen)) {
+                ++num_unclaimed;
+                (*task)();
+                #if PAR_DEBUG_STATS
+                ++dstats.num_tasks_stolen;
+                ++dstats.num_tasks_executed;
+                #endif
+            }
+            if (num_unclaimed && m_scaling.auto_scale && num_threads() < m_scaling.max_threads) {
+                try_grow(num_unclaimed);
+            }
+        }
+        else if (region) {
+            // claim the jobs of our region which no worker has claimed yet
+            while (auto task = region->claim()) {
+                (*task)();
                 #if PAR_DEBUG_STATS
                 ++dstats.num_tasks_stolen;
                 ++dstats.num_tasks_executed;
                 #endif
             }
+
+            // workers unlink exhausted regions which they find, but ours may still be in its shard
+            unlink_pending_region(*region);
+        }
+
+        for (uint32_t i = num_worker_jobs - num_retired_jobs + 1; i <= num_worker_jobs; ++i) {
+            worker_task{i, func, &latch}();
         }
 
         latch.wait(); // wait for all tasks to finish
         return num_worker_jobs + 1;
     }
+
+    // a task of run_task_async
+    // the pool owns it until its jobs finish, then the next async task or the destructor frees it
+    struct async_region {
+        async_task_func func;
+        completion_func on_complete;
+        std::atomic_uint32_t num_unfinished;
+        std::latch latch; // counted down by the worker tasks after the jobs
+        std::optional<pending_region> pending; // the jobs which no idle worker took
+
+        async_region(async_task_func&& f, completion_func&& c, uint32_t n)
+            : func(std::move(f))
+            , on_complete(std::move(c))
+            , num_unfinished(n)
+            , latch(n)
+        {}
+
+        // the indices of worker tasks start from 1, as in run_task
+        void operator()(uint32_t index) {
+            func(index - 1);
+            if (num_unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                func.reset();
+                on_complete();
+                // don't keep its captures alive until the region is freed
+                on_complete.reset();
+            }
+        }
+    };
+
+    std::mutex m_async_mutex;
+    std::vector<std::unique_ptr<async_region>> m_async_regions;
+
+    // must be called with m_async_mutex locked
+    void free_finished_async_regions_locked() {
+        std::erase_if(m_async_regions, [&](const std::unique_ptr<async_region>& r) {
+            if (!r->latch.try_wait()) return false;
+            if (r->pending) {
+                unlink_pending_region(*r->pending);
+            }
+            return true;
+        });
+    }
+
+    void wait_for_async_regions() {
+        // completion callbacks may run more async tasks in the meantime
+        while (true) {
+            std::vector<std::unique_ptr<async_region>> regions;
+            {
+                std::lock_guard lock(m_async_mutex);
+                regions.swap(m_async_regions);
+            }
+            if (regions.empty()) return;
+            for (auto& r : regions) {
+                if (r->pending) {
+                    // the pool may have shrunk since, so run the jobs which no worker has claimed
+                    while (auto task = r->pending->claim()) {
+                        (*task)();
+                    }
+                    unlink_pending_region(*r->pending);
+                }
+                r->latch.wait();
+            }
+        }
+    }
+
+    uint32_t run_task_async(const run_opts& opts, async_task_func func, completion_func on_complete) {
+        uint32_t num_jobs = num_planned_threads();
+        if (opts.max_par) {
+            num_jobs = std::min(num_jobs, opts.max_par);
+        }
+        if (opts.sched == schedule_dynamic_no_nesting && current_thread_is_worker()) {
+            num_jobs = std::min(num_jobs, 1u);
+        }
+
+        if (num_jobs == 0) {
+            // no workers
+            {
+                region_scope region;
+                scratch_arena::scope scratch;
+                func(0);
+            }
+            func.reset();
+            on_complete();
+            return 1;
+        }
+
+        if (num_jobs > num_threads() && m_num_lazy_threads.load(std::memory_order_relaxed)) {
+            // never wait, not even on non-workers, as the caller must not block
+            start_lazy_workers(num_jobs, false);
+        }
+
+        auto r = std::make_unique<async_region>(std::move(func), std::move(on_complete), num_jobs);
+        auto& region = *r;
+        const task_func job(region);
+        {
+            std::lock_guard lock(m_async_mutex);
+            free_finished_async_regions_locked();
+            m_async_regions.push_back(std::move(r));
+        }
+
+        // as the dynamic regions of run_task, but there is no caller job to claim what's left
+        // the region must not be touched after its last job is handed out, as it may finish and be freed
+        const auto num_workers = num_threads();
+        uint32_t index = 0;
+        if (opts.priority != priority_background) {
+            for (uint32_t wi = 0; wi < num_workers; ++wi) {
+                if (m_workers[wi]->try_add_task({ index + 1, job, &region.latch })) {
+                    ++index;
+                    if (index == num_jobs) {
+                        return num_jobs;
+                    }
+                }
+            }
+        }
+
+        region.pending.emplace(index, num_jobs, job, region.latch, opts.priority, shard_hint % num_submission_shards);
+        link_pending_region(*region.pending);
+        for (uint32_t wi = 0; wi < num_workers; ++wi) {
+            if (m_workers[wi]->try_wake_up_if_idle()) {
+                ++index;
+                if (index == num_jobs) {
+                    break;
+                }
+            }
+        }
+        if (index < num_jobs) {
+            notify_federation(num_jobs - index);
+        }
+        if (index < num_jobs && m_scaling.auto_scale && num_workers < m_scaling.max_threads) {
+            try_grow(num_jobs - index);
+        }
+        return num_jobs;
+    }
 };
 
 #if PAR_DEBUG_STATS
@@ -423,7 +1613,13 @@ thread_local thread_pool::impl::worker* thread_pool::impl::current_worker = null
 #endif
 
 thread_pool::thread_pool(std::string name, uint32_t nthreads, debug_stats* ds)
-    : m_impl(std::make_unique<impl>(std::move(name), nthreads, ds))
+    : m_impl(std::make_unique<impl>(
+        std::move(name), nthreads, scaling_opts{.min_threads = 0, .max_threads = nthreads, .auto_scale = false}, ds
+    ))
+{}
+
+thread_pool::thread_pool(std::string name, uint32_t nthreads, const scaling_opts& scaling, debug_stats* ds)
+    : m_impl(std::make_unique<impl>(std::move(name), nthreads, scaling, ds))
 {}
 
 thread_pool::~thread_pool() = default;
@@ -436,51 +1632,173 @@ uint32_t thread_pool::run_task(run_opts opts, task_func task) {
     return m_impl->run_task(opts, std::move(task));
 }
 
+uint32_t thread_pool::run_task_async(run_opts opts, async_task_func task, completion_func on_complete) {
+    return m_impl->run_task_async(opts, std::move(task), std::move(on_complete));
+}
+
 uint32_t thread_pool::num_threads() const {
+    return m_impl->num_planned_threads();
+}
+
+uint32_t thread_pool::num_running_threads() const {
+    return m_impl->num_threads();
+}
+
+namespace {
+// touch at least size bytes of the stack of the current thread, so that its pages are mapped
+NO_INLINE void touch_stack(size_t size) {
+    volatile char buf[4096];
+    buf[0] = 0;
+    if (size > sizeof(buf)) {
+        touch_stack(size - sizeof(buf));
+    }
+    buf[sizeof(buf) - 1] = buf[0]; // after the call, so that it's not a tail call reusing this frame
+}
+} // namespace
+
+void thread_pool::warm_up(size_t stack_size) {
+    // stay well within the smallest default stacks
+    stack_size = std::min(stack_size, size_t(256 * 1024));
+
+    m_impl->start_lazy_workers(m_impl->num_planned_threads(), true);
+
+    auto touch = [&](uint32_t) {
+        touch_stack(stack_size);
+    };
+    run_task({.sched = schedule_static}, task_func(touch));
+}
+
+uint32_t thread_pool::max_threads() const {
     return uint32_t(m_impl->m_workers.size());
 }
 
+void thread_pool::resize(uint32_t nthreads) {
+    m_impl->resize(nthreads);
+}
+
+std::optional<uint32_t> thread_pool::current_worker_index() const {
+    return m_impl->current_worker_index();
+}
+
+bool thread_pool::have_higher_priority_work(priority_class prio) const {
+    return m_impl->have_higher_priority_work(prio);
+}
+
 uint32_t thread_pool::get_par(run_opts opts) const {
     return m_impl->get_par(opts);
 }
 
+federation::federation()
+    : m_impl(std::make_unique<impl>())
+{}
+
+federation::~federation() {
+    // member pools must be destroyed before the federation
+    assert(m_impl->m_members.empty());
+}
+
+void federation::add(thread_pool& pool) {
+    add(pool, member_opts{});
+}
+
+void federation::add(thread_pool& pool, const member_opts& opts) {
+    auto& pimpl = *pool.m_impl;
+
+    std::unique_lock lock(m_impl->m_mutex);
+    if (pimpl.m_federation.load(std::memory_order_relaxed)) {
+        throw std::runtime_error("par::thread_pool is already in a federation");
+    }
+    pimpl.m_max_lent_workers = opts.max_lent_workers;
+    pimpl.m_max_borrowed_jobs = opts.max_borrowed_jobs;
+    m_impl->m_members.push_back(&pimpl);
+    pimpl.m_federation.store(m_impl.get(), std::memory_order_release);
+}
+
 // global thread pool management
 
 namespace {
 
-std::atomic_flag global_initialized = ATOMIC_FLAG_INIT;
+// set only after the pool is constructed, so that a constructor which throws leaves the global pool uninitialized
+std::atomic<thread_pool*> global_thread_pool_ptr = nullptr;
+
+// serializes initialization
+std::mutex global_init_mutex;
 
 std::unique_ptr<thread_pool> global_thread_pool;
 
+// called with global_init_mutex locked
 thread_pool& do_init_global(uint32_t nthreads) {
-    global_thread_pool = std::make_unique<thread_pool>("gpar", nthreads);
+    // the cpu quota of the process may rise later, but it can't use more cpus than its affinity allows
+    const auto affinity = affinity_cpus();
+    const uint32_t cpus = affinity && *affinity ? *affinity : std::thread::hardware_concurrency();
+    const uint32_t max_threads = std::max(nthreads, std::min(cpus, thread_pool::max_threads_limit));
+
+    // processes which are short-lived or rarely run parallel regions don't pay for all workers
+    global_thread_pool = std::make_unique<thread_pool>("gpar", nthreads, thread_pool::scaling_opts{
+        .min_threads = 0,
+        .max_threads = max_threads,
+        .auto_scale = false,
+        .lazy = true,
+    });
+    global_thread_pool_ptr.store(global_thread_pool.get(), std::memory_order_release);
     return *global_thread_pool;
 }
 
 } // namespace
 
 thread_pool& thread_pool::global() {
-    if (!global_initialized.test_and_set(std::memory_order_acquire)) {
-        constexpr uint32_t other_threads = 2;
-        const auto hwc = std::thread::hardware_concurrency();
-        if (hwc <= other_threads) {
-            // no workers, only caller thread
-            return do_init_global(0);
-        }
-        else {
-            return do_init_global(hwc - other_threads);
-        }
-    }
-    return *global_thread_pool;
+    if (auto p = global_thread_pool_ptr.load(std::memory_order_acquire)) return *p;
+
+    std::lock_guard lock(global_init_mutex);
+    if (auto p = global_thread_pool_ptr.load(std::memory_order_relaxed)) return *p;
+
+    // with no available cpus besides the reserved ones, there are no workers, only the caller thread
+    return do_init_global(default_num_threads());
+}
+
+bool thread_pool::at_region_end(completion_func func) {
+    if (!region_depth) return false;
+    region_end_funcs.push_back(std::move(func));
+    return true;
 }
 
 thread_pool& thread_pool::init_global(uint32_t nthreads) {
-    if (global_initialized.test_and_set(std::memory_order_acquire)) {
+    std::lock_guard lock(global_init_mutex);
+    if (global_thread_pool_ptr.load(std::memory_order_relaxed)) {
         throw std::runtime_error("global par::thread_pool already initialized");
     }
     return do_init_global(nthreads);
 }
 
+scratch_arena& scratch_arena::current() {
+    if (worker_scratch) return *worker_scratch;
+    thread_local scratch_arena thread_scratch;
+    return thread_scratch;
+}
+
+task_group::task_group(thread_pool& pool)
+    : m_pool(pool)
+{}
+
+task_group::~task_group() {
+    m_pool.m_impl->wait_for_group(*this);
+}
+
+void task_group::spawn_task(task t) {
+    m_pool.m_impl->spawn(*this, std::move(t));
+}
+
+void task_group::wait() {
+    m_pool.m_impl->wait_for_group(*this);
+
+    // the tasks are done, so m_exception is no longer written
+    if (m_failed.test(std::memory_order_relaxed)) {
+        auto e = std::exchange(m_exception, nullptr);
+        m_failed.clear(std::memory_order_relaxed);
+        std::rethrow_exception(e);
+    }
+}
+
 bool thread_pool::have_debug_stats() const {
     #if PAR_DEBUG_STATS
     return true;
@@ -5,7 +5,10 @@
 #include "api.h"
 #include "run_opts.hpp"
 #include "bits/te_func_ptr.hpp"
+#include "bits/inplace_task.hpp"
 #include <memory>
+#include <optional>
+#include <chrono>
 #include <cstdint>
 #include <string>
 #include <type_traits>
@@ -18,13 +21,40 @@ struct debug_stats;
 
 class PAR_API thread_pool {
 public:
+    // the global pool can be resized up to the number of cpus in the affinity mask of the process (or nthreads if
+    // it's more), so that it can follow changes of the cpu quota
     static thread_pool& global();
     static thread_pool& init_global(uint32_t nthreads);
 
+    // the maximum number of threads of any pool
+    static constexpr uint32_t max_threads_limit = 0x7FFF;
+
+    // elastic pools
+    // the number of threads can be changed at runtime with resize() up to max_threads
+    // with auto_scale the pool also resizes itself between min_threads and max_threads:
+    // * it grows when there are more dynamic jobs than idle workers to take them
+    // * it shrinks when the last worker has been idle for idle_timeout
+    // lazy pools don't start their workers in the constructor (or resize), but when a task first needs them
+    // (the global pool is lazy)
+    struct scaling_opts {
+        uint32_t min_threads = 0;
+        uint32_t max_threads = 0; // 0 means max(nthreads, min_threads)
+        bool auto_scale = true;
+        std::chrono::milliseconds idle_timeout{1000};
+        bool lazy = false;
+        // sleeping workers are woken up for broadcast regions in a tree with this many children per node
+        // 0 means the caller wakes them all up itself
+        uint32_t wake_up_fanout = 4;
+    };
+
     // debug stats are conditionally compiled in
     // if PAR_DEBUG_STATS is not defined to a truthy value, this parameter is ignored
     // if debug stats are available, the data is only reliable after the thread_pool is destroyed
+    // pools constructed without scaling_opts have a fixed size: max_threads is nthreads and they don't auto-scale
     thread_pool(std::string name, uint32_t nthreads, debug_stats* ds = nullptr);
+
+    // nthreads is clamped to [min_threads, max_threads]
+    thread_pool(std::string name, uint32_t nthreads, const scaling_opts& scaling, debug_stats* ds = nullptr);
     ~thread_pool();
 
     // utility function to check if debug stats are available
@@ -38,14 +68,56 @@ public:
     using task_func = te_func_ptr<void(uint32_t)>;
 
     // return the number of threads used to run the task, including the caller thread
+    // if opts.max_par was adjusted by adjust_par (see run_opts::max_par_adjusted), exactly this many jobs are run,
+    // even if the pool shrinks in the meantime, in which case the caller runs the jobs of the missing workers after
+    // its own (so not all of them run concurrently)
     uint32_t run_task(run_opts opts, task_func task);
     uint32_t run_task(task_func task, run_opts opts = {}) {
         return run_task(opts, std::move(task));
     }
 
+    using async_task_func = inplace_task<void(uint32_t)>;
+    using completion_func = inplace_task<void()>;
+
+    // run the task without blocking the caller (for threads which must not block, like event loops)
+    // the caller doesn't run a job: all jobs, with indices [0, n), run on workers
+    // n is opts.max_par clamped to the number of workers, or all workers if it's 0
+    // the last job to finish destroys the task, then calls on_complete on its thread and destroys it
+    // the pool owns both until then, so they must capture what they need by value
+    // schedule_static is treated as schedule_dynamic, as the jobs are not guaranteed to run concurrently
+    // in a pool without workers the task and on_complete run on the caller before this returns
+    // lazy workers are started without waiting: if the pool is busy resizing, they're started when it's done
+    // the destructor of the pool waits for the async tasks, on_complete must not destroy the pool
+    // return n
+    uint32_t run_task_async(run_opts opts, async_task_func task, completion_func on_complete);
+
+    // call func on the current thread when the outermost region it runs ends: run_task (and other par calls) on
+    // the caller, a job on a worker, or task_group::wait
+    // for state bound to threads which run jobs of a pool without being its workers (see per_worker)
+    // return false without storing func if the thread is not running one
+    static bool at_region_end(completion_func func);
+
     // note that this does not include the caller thread
+    // in lazy pools this includes workers which haven't been started yet
     uint32_t num_threads() const;
 
+    // the number of worker threads which have been started
+    uint32_t num_running_threads() const;
+
+    // start all workers of a lazy pool and have each of them touch stack_size bytes of its stack, so that the first
+    // regions don't pay for starting threads and mapping stack pages
+    // stack_size is clamped to 256 KiB, as stacks may be as small as 512 KiB (macOS) and the caller touches its own
+    // must not be called from a worker of the pool
+    void warm_up(size_t stack_size = 64 * 1024);
+
+    // the maximum number of threads the pool can be resized to
+    uint32_t max_threads() const;
+
+    // set the number of worker threads
+    // throw if nthreads > max_threads() or if called from a worker of the pool
+    // running tasks are not affected: retired threads finish their current jobs before they are joined
+    void resize(uint32_t nthreads);
+
     uint32_t max_parallel_jobs() const {
         return num_threads() + 1;
     }
@@ -71,11 +143,13 @@ public:
         if constexpr (sizeof(I) <= sizeof(uint32_t)) {
             auto ret = std::min(uint32_t(size), opar);
             opts.max_par = ret;
+            opts.max_par_adjusted = true;
             return I(ret);
         }
         else {
             auto ret = std::min(size, I(opar));
             opts.max_par = uint32_t(ret);
+            opts.max_par_adjusted = true;
             return ret;
         }
     }
@@ -88,8 +162,19 @@ public:
     // check if the current thread is one of the worker threads of this pool
     bool current_thread_is_worker() const;
 
+    // the index of the current thread in [0, max_threads()) if it's one of the worker threads of this pool
+    // unlike current_thread_is_worker(), this is empty for workers of other pools which run jobs of this one
+    // (see federation.hpp)
+    std::optional<uint32_t> current_worker_index() const;
+
+    // check if there is pending work of a higher priority than prio
+    // background jobs which run for a long time can use it to yield at convenient points
+    bool have_higher_priority_work(priority_class prio) const;
+
     struct impl;
 private:
+    friend class federation;
+    friend class task_group;
     std::unique_ptr<impl> m_impl;
 };
 
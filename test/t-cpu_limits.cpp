@@ -0,0 +1,201 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/cpu_limits.hpp>
+#include <par/thread_pool.hpp>
+#include <doctest/doctest.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// a fake cgroup filesystem and /proc/self/cgroup in a temporary directory
+struct fake_cgroups {
+    fs::path dir;
+    par::cpu_limits_opts opts;
+
+    fake_cgroups() {
+        dir = fs::temp_directory_path() / ("par-test-cgroups-" + std::to_string(std::rand()));
+        fs::remove_all(dir);
+        fs::create_directories(dir / "fs");
+        opts.cgroup_root = (dir / "fs").string();
+        opts.proc_self_cgroup = (dir / "cgroup").string();
+    }
+
+    ~fake_cgroups() {
+        fs::remove_all(dir);
+    }
+
+    void proc_self_cgroup(const std::string& contents) {
+        std::ofstream(dir / "cgroup") << contents;
+    }
+
+    void file(const std::string& path, const std::string& contents) {
+        auto p = dir / "fs" / path;
+        fs::create_directories(p.parent_path());
+        std::ofstream(p) << contents;
+    }
+};
+
+} // namespace
+
+TEST_CASE("no cgroups") {
+    fake_cgroups fc;
+    CHECK_FALSE(par::cgroup_cpu_quota(fc.opts));
+
+    fc.proc_self_cgroup("0::/\n");
+    CHECK_FALSE(par::cgroup_cpu_quota(fc.opts));
+}
+
+TEST_CASE("cgroup v2") {
+    fake_cgroups fc;
+    fc.proc_self_cgroup("0::/\n");
+
+    fc.file("cpu.max", "max 100000\n");
+    CHECK_FALSE(par::cgroup_cpu_quota(fc.opts));
+
+    fc.file("cpu.max", "400000 100000\n");
+    CHECK(par::cgroup_cpu_quota(fc.opts) == 4u);
+
+    // rounded down, but at least one cpu
+    fc.file("cpu.max", "250000 100000\n");
+    CHECK(par::cgroup_cpu_quota(fc.opts) == 2u);
+    fc.file("cpu.max", "50000 100000\n");
+    CHECK(par::cgroup_cpu_quota(fc.opts) == 1u);
+
+    // the lowest quota in the hierarchy
+    fc.proc_self_cgroup("0::/kubepods/pod1/c1\n");
+    fc.file("cpu.max", "max 100000\n");
+    fc.file("kubepods/cpu.max", "800000 100000\n");
+    fc.file("kubepods/pod1/cpu.max", "300000 100000\n");
+    fc.file("kubepods/pod1/c1/cpu.max", "max 100000\n");
+    CHECK(par::cgroup_cpu_quota(fc.opts) == 3u);
+
+    // only the ancestors are visible
+    fc.proc_self_cgroup("0::/kubepods/pod1/c2\n");
+    CHECK(par::cgroup_cpu_quota(fc.opts) == 3u);
+
+    // malformed
+    fc.proc_self_cgroup("0::/\n");
+    fc.file("cpu.max", "garbage\n");
+    CHECK_FALSE(par::cgroup_cpu_quota(fc.opts));
+}
+
+TEST_CASE("cgroup v1") {
+    fake_cgroups fc;
+    fc.proc_self_cgroup(
+        "12:memory:/docker/abc\n"
+        "4:cpu,cpuacct:/docker/abc\n"
+        "3:cpuset:/docker/abc\n"
+    );
+
+    fc.file("cpu,cpuacct/docker/abc/cpu.cfs_quota_us", "-1\n");
+    fc.file("cpu,cpuacct/docker/abc/cpu.cfs_period_us", "100000\n");
+    CHECK_FALSE(par::cgroup_cpu_quota(fc.opts));
+
+    fc.file("cpu,cpuacct/docker/abc/cpu.cfs_quota_us", "600000\n");
+    CHECK(par::cgroup_cpu_quota(fc.opts) == 6u);
+
+    // a memory quota doesn't matter
+    fc.file("memory/docker/abc/cpu.cfs_quota_us", "100000\n");
+    fc.file("memory/docker/abc/cpu.cfs_period_us", "100000\n");
+    CHECK(par::cgroup_cpu_quota(fc.opts) == 6u);
+
+    // the cgroup of the container mounted as the root
+    fs::remove_all(fc.dir / "fs" / "cpu,cpuacct");
+    fc.file("cpu/cpu.cfs_quota_us", "200000\n");
+    fc.file("cpu/cpu.cfs_period_us", "100000\n");
+    CHECK(par::cgroup_cpu_quota(fc.opts) == 2u);
+}
+
+TEST_CASE("available cpus") {
+    fake_cgroups fc;
+    fc.proc_self_cgroup("0::/\n");
+
+    const auto hwc = std::thread::hardware_concurrency();
+    const auto aff = par::affinity_cpus();
+    #if defined(__linux__)
+    CHECK(aff);
+    #endif
+    if (aff) {
+        CHECK(*aff >= 1);
+        if (hwc) CHECK(*aff <= hwc);
+    }
+
+    const auto unlimited = par::available_cpus(fc.opts);
+    CHECK(unlimited >= 1);
+    if (aff) CHECK(unlimited == *aff);
+
+    fc.file("cpu.max", "100000 100000\n");
+    CHECK(par::available_cpus(fc.opts) == 1);
+
+    fc.file("cpu.max", "100000000 100000\n");
+    CHECK(par::available_cpus(fc.opts) == unlimited);
+}
+
+TEST_CASE("default num threads") {
+    fake_cgroups fc;
+    fc.proc_self_cgroup("0::/\n");
+    fc.file("cpu.max", "100000000 100000\n");
+    const auto cpus = par::available_cpus(fc.opts);
+
+    par::default_threads_opts opts;
+    opts.limits = fc.opts;
+    opts.num_threads_env = nullptr;
+    opts.reserved_threads_env = nullptr;
+
+    opts.reserved_threads = 0;
+    CHECK(par::default_num_threads(opts) == cpus);
+    opts.reserved_threads = 1;
+    CHECK(par::default_num_threads(opts) == cpus - 1);
+    opts.reserved_threads = cpus + 5;
+    CHECK(par::default_num_threads(opts) == 0);
+
+    // 4 cpus quota on a larger machine
+    fc.file("cpu.max", "400000 100000\n");
+    opts.reserved_threads = 2;
+    CHECK(par::default_num_threads(opts) == std::min(cpus, 4u) - std::min(cpus, 2u));
+
+#if defined(__unix__)
+    opts.num_threads_env = "PAR_TEST_NUM_THREADS";
+    opts.reserved_threads_env = "PAR_TEST_RESERVED_THREADS";
+
+    setenv("PAR_TEST_RESERVED_THREADS", "0", 1);
+    CHECK(par::default_num_threads(opts) == std::min(cpus, 4u));
+
+    setenv("PAR_TEST_NUM_THREADS", "13", 1);
+    CHECK(par::default_num_threads(opts) == 13);
+
+    // clamped to what a pool can have
+    setenv("PAR_TEST_NUM_THREADS", "100000", 1);
+    CHECK(par::default_num_threads(opts) == par::thread_pool::max_threads_limit);
+
+    // ignored if not a number
+    setenv("PAR_TEST_NUM_THREADS", "many", 1);
+    CHECK(par::default_num_threads(opts) == std::min(cpus, 4u));
+
+    unsetenv("PAR_TEST_NUM_THREADS");
+    unsetenv("PAR_TEST_RESERVED_THREADS");
+#endif
+}
+
+#if defined(__unix__)
+TEST_CASE("global pool with too many threads") {
+    // a failed initialization leaves the global pool uninitialized
+    CHECK_THROWS(par::thread_pool::init_global(par::thread_pool::max_threads_limit + 1));
+
+    setenv("PAR_NUM_THREADS", "4294967295", 1);
+    auto& pool = par::thread_pool::global();
+    unsetenv("PAR_NUM_THREADS");
+
+    // lazy, so the workers aren't started
+    CHECK(pool.num_threads() == par::thread_pool::max_threads_limit);
+    CHECK(&par::thread_pool::global() == &pool);
+    CHECK_THROWS(par::thread_pool::init_global(1));
+}
+#endif
@@ -0,0 +1,90 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/execution.hpp>
+#include <doctest/doctest.h>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+static_assert(stdexec::scheduler<par::scheduler>);
+
+TEST_CASE("schedule") {
+    par::thread_pool pool("test", 3);
+    par::scheduler sched(pool);
+    CHECK(sched == par::scheduler(pool, {.max_par = 2}));
+    CHECK(stdexec::get_forward_progress_guarantee(sched) == stdexec::forward_progress_guarantee::parallel);
+
+    auto snd = stdexec::schedule(sched) | stdexec::then([&]() {
+        return pool.current_thread_is_worker();
+    });
+    auto [on_worker] = stdexec::sync_wait(std::move(snd)).value();
+    CHECK(on_worker);
+    CHECK(stdexec::get_completion_scheduler<stdexec::set_value_t>(stdexec::get_env(stdexec::schedule(sched))) == sched);
+
+    // a pool without workers completes inline
+    par::thread_pool none("none", 0);
+    const auto caller = std::this_thread::get_id();
+    auto [id] = stdexec::sync_wait(stdexec::schedule(par::scheduler(none)) | stdexec::then([]() {
+        return std::this_thread::get_id();
+    })).value();
+    CHECK(id == caller);
+}
+
+TEST_CASE("bulk") {
+    par::thread_pool pool("test", 3);
+    par::scheduler sched(pool, {}, {.chunks_per_job = 4});
+
+    std::vector<std::atomic_uint32_t> hits(10'000);
+    auto snd = stdexec::schedule(sched)
+        | stdexec::then([]() { return 5; })
+        | stdexec::bulk(int(hits.size()), [&](int i, int& v) {
+            hits[i] += v;
+        });
+    auto [v] = stdexec::sync_wait(std::move(snd)).value();
+    CHECK(v == 5);
+    bool ok = true;
+    for (auto& h : hits) {
+        ok = ok && h == 5;
+    }
+    CHECK(ok);
+
+    // errors on the completing thread
+    auto bad = stdexec::schedule(par::scheduler(pool, {.max_par = 1}))
+        | stdexec::bulk(10, [](int i) {
+            if (i == 7) throw std::runtime_error("bulk");
+        });
+    CHECK_THROWS_AS(stdexec::sync_wait(std::move(bad)), std::runtime_error);
+
+    // errors on workers
+    auto bad_par = stdexec::schedule(par::scheduler(pool, {.max_par = 0}))
+        | stdexec::bulk(10'000, [](int i) {
+            if (i % 1000 == 999) throw std::runtime_error("bulk");
+        });
+    CHECK_THROWS_AS(stdexec::sync_wait(std::move(bad_par)), std::runtime_error);
+}
+
+TEST_CASE("bulk static") {
+    par::thread_pool pool("test", 3);
+
+    // schedule() completes on a worker, where static bulk work runs dynamically
+    par::scheduler sched(pool, {.sched = par::schedule_static, .max_par = 0});
+    std::vector<std::atomic_uint32_t> hits(10'000);
+    auto snd = stdexec::schedule(sched)
+        | stdexec::bulk(int(hits.size()), [&](int i) {
+            ++hits[i];
+        });
+    CHECK(stdexec::sync_wait(std::move(snd)).has_value());
+    bool ok = true;
+    for (auto& h : hits) {
+        ok = ok && h == 1;
+    }
+    CHECK(ok);
+
+    auto bad = stdexec::schedule(sched)
+        | stdexec::bulk(10'000, [](int i) {
+            if (i == 5000) throw std::runtime_error("bulk");
+        });
+    CHECK_THROWS_AS(stdexec::sync_wait(std::move(bad)), std::runtime_error);
+}
@@ -0,0 +1,202 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/federation.hpp>
+#include <par/thread_pool.hpp>
+#include <par/prun.hpp>
+#include <doctest/doctest.h>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+void sleep_ms(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+std::set<std::thread::id> worker_ids(par::thread_pool& pool) {
+    std::vector<std::thread::id> ids(pool.max_parallel_jobs());
+    prun(pool, {.sched = par::schedule_static}, [&](uint32_t i) {
+        ids[i] = std::this_thread::get_id();
+    });
+    ids.erase(ids.begin()); // caller
+    return {ids.begin(), ids.end()};
+}
+
+// keep all workers of a pool busy until release is set
+class blocker {
+    std::atomic_uint32_t m_started = 0;
+    std::atomic_bool m_release = false;
+    std::thread m_thread;
+public:
+    explicit blocker(par::thread_pool& pool)
+        : m_thread([&]() {
+            const auto num_workers = pool.num_threads();
+            prun(pool, {}, [&](uint32_t i) {
+                if (i == 0) {
+                    // make sure the workers run the other jobs
+                    while (m_started != num_workers) sleep_ms(1);
+                    return;
+                }
+                ++m_started;
+                while (!m_release) sleep_ms(1);
+            });
+        })
+    {
+        while (m_started != pool.num_threads()) sleep_ms(1);
+    }
+
+    ~blocker() {
+        m_release = true;
+        m_thread.join();
+    }
+};
+} // namespace
+
+TEST_CASE("federation lending") {
+    par::federation fed;
+    par::thread_pool a("a", 2);
+    par::thread_pool b("b", 2);
+    fed.add(a);
+    fed.add(b);
+    CHECK_THROWS(fed.add(a));
+
+    const auto a_ids = worker_ids(a);
+
+    blocker block(b);
+
+    std::atomic_bool done = false;
+    std::thread::id lent_id;
+    bool a_worker = false, b_worker = false, static_throws = false;
+    uint32_t b_par = 0;
+
+    // b's workers are busy, so the job is queued for a's idle workers
+    prun(b, {.max_par = 2}, [&](uint32_t i) {
+        if (i == 0) {
+            for (int w = 0; w < 5000 && !done; ++w) sleep_ms(1);
+            return;
+        }
+        lent_id = std::this_thread::get_id();
+        a_worker = a.current_thread_is_worker();
+        b_worker = b.current_thread_is_worker();
+        b_par = b.get_par({.sched = par::schedule_dynamic_no_nesting});
+        try {
+            prun(a, {.sched = par::schedule_static}, [](uint32_t) {});
+        }
+        catch (std::runtime_error&) {
+            static_throws = true;
+        }
+        done = true;
+    });
+
+    CHECK(done);
+    CHECK(a_ids.contains(lent_id));
+    CHECK(a_worker);
+    CHECK(b_worker);
+    CHECK(b_par == 1);
+    CHECK(static_throws);
+
+    // the lender is a worker of its own pool again
+    CHECK(worker_ids(a) == a_ids);
+    CHECK_FALSE(a.current_thread_is_worker());
+}
+
+TEST_CASE("federation limits") {
+    par::federation fed;
+    par::thread_pool a("a", 2);
+    par::thread_pool b("b", 2);
+    par::thread_pool c("c", 2);
+    fed.add(a, {.max_lent_workers = 0});
+    fed.add(b);
+    fed.add(c, {.max_borrowed_jobs = 0});
+
+    auto run_blocked = [&](par::thread_pool& owner) {
+        blocker block(owner);
+        std::thread::id job_id;
+        prun(owner, {.max_par = 2}, [&](uint32_t i) {
+            if (i == 0) {
+                // give others the chance to borrow the job
+                sleep_ms(50);
+                return;
+            }
+            job_id = std::this_thread::get_id();
+        });
+        return job_id;
+    };
+
+    const auto a_ids = worker_ids(a);
+    const auto b_ids = worker_ids(b);
+
+    // a doesn't lend, b does
+    CHECK(b_ids.contains(run_blocked(a)));
+    auto id = run_blocked(b);
+    CHECK_FALSE(a_ids.contains(id));
+    CHECK_FALSE(b_ids.contains(id));
+
+    // no one borrows from c
+    CHECK(run_blocked(c) == std::this_thread::get_id());
+}
+
+TEST_CASE("federation borrow limit") {
+    par::federation fed;
+    par::thread_pool a("a", 2);
+    par::thread_pool b("b", 3);
+    fed.add(a);
+    fed.add(b, {.max_borrowed_jobs = 1});
+
+    const auto a_ids = worker_ids(a);
+    blocker block(b);
+
+    // fewer jobs than workers of b, so they are queued for others instead of broadcast
+    // only one job of b runs on a at a time
+    // the other is lent when the first one finishes, though searches have skipped it in the meantime
+    std::atomic_uint32_t num_borrowed = 0, max_borrowed = 0, num_lent = 0;
+    prun(b, {.max_par = 3}, [&](uint32_t i) {
+        if (i == 0) {
+            for (int w = 0; w < 5000 && num_lent != 2; ++w) sleep_ms(1);
+            return;
+        }
+        if (!a_ids.contains(std::this_thread::get_id())) return;
+        const auto n = ++num_borrowed;
+        if (n > max_borrowed) max_borrowed = n;
+        sleep_ms(20);
+        --num_borrowed;
+        ++num_lent;
+    });
+    CHECK(num_lent == 2);
+    CHECK(max_borrowed == 1);
+}
+
+TEST_CASE("federation stress") {
+    par::federation fed;
+    par::thread_pool a("a", 2);
+    par::thread_pool b("b", 3);
+    fed.add(a, {.max_lent_workers = 1});
+    fed.add(b);
+
+    auto run = [](par::thread_pool& pool) {
+        for (int n = 0; n < 200; ++n) {
+            std::atomic_uint32_t calls = 0;
+            auto ret = prun(pool, {}, [&](uint32_t) {
+                ++calls;
+                std::atomic_uint32_t ncalls = 0;
+                auto nret = prun(pool, {}, [&](uint32_t) {
+                    ++ncalls;
+                });
+                CHECK(ncalls == nret);
+            });
+            CHECK(calls == ret);
+        }
+    };
+
+    std::thread ta1([&]() { run(a); });
+    std::thread ta2([&]() { run(a); });
+    std::thread tb1([&]() { run(b); });
+    std::thread tb2([&]() { run(b); });
+    ta1.join();
+    ta2.join();
+    tb1.join();
+    tb2.join();
+}
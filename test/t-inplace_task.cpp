@@ -0,0 +1,79 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/bits/inplace_task.hpp>
+#include <doctest/doctest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+TEST_CASE("inplace_task empty") {
+    par::inplace_task<void()> t;
+    CHECK(!t);
+    par::inplace_task<void()> n = nullptr;
+    CHECK(!n);
+    CHECK(sizeof(t) <= 64);
+}
+
+TEST_CASE("inplace_task lambda") {
+    int x = 0;
+    par::inplace_task<void(int)> t = [&](int v) { x += v; };
+    CHECK(!!t);
+    t(3);
+    t(4);
+    CHECK(x == 7);
+
+    t.reset([&](int v) { x = v * 2; });
+    t(5);
+    CHECK(x == 10);
+
+    t.reset();
+    CHECK(!t);
+
+    // mutable state is owned by the task
+    par::inplace_task<int()> counter = [n = 0]() mutable { return ++n; };
+    CHECK(counter() == 1);
+    CHECK(counter() == 2);
+    auto moved = std::move(counter);
+    CHECK(!counter);
+    CHECK(moved() == 3);
+}
+
+TEST_CASE("inplace_task function pointer") {
+    par::inplace_task<int(int)> t = +[](int v) { return v * 3; };
+    CHECK(t(4) == 12);
+}
+
+TEST_CASE("inplace_task ownership") {
+    auto sp = std::make_shared<int>(5);
+    std::weak_ptr<int> wp = sp;
+    {
+        par::inplace_task<int()> t = [sp = std::move(sp)]() { return *sp; };
+        CHECK(!wp.expired());
+        CHECK(t() == 5);
+
+        par::inplace_task<int()> t2;
+        t2 = std::move(t);
+        CHECK(!t);
+        CHECK(!wp.expired());
+        CHECK(t2() == 5);
+
+        // outlives the scope in which it was created
+        std::vector<par::inplace_task<int()>> tasks;
+        tasks.push_back(std::move(t2));
+        for (int i = 0; i < 20; ++i) {
+            tasks.push_back([i] { return i; });
+        }
+        CHECK(tasks.front()() == 5);
+        CHECK(tasks.back()() == 19);
+
+        tasks.front() = [] { return 1; };
+        CHECK(wp.expired());
+        CHECK(tasks.front()() == 1);
+    }
+
+    std::string str = "a string which is not stored in the small buffer of std::string";
+    par::inplace_task<size_t(size_t)> t = [str](size_t i) { return str.size() + i; };
+    auto t2 = std::move(t);
+    CHECK(t2(1) == str.size() + 1);
+}
@@ -3,7 +3,10 @@
 //
 #include <par/pchunk.hpp>
 #include <doctest/doctest.h>
+#include <atomic>
+#include <chrono>
 #include <mutex>
+#include <thread>
 #include <vector>
 #include <utility>
 #include <algorithm>
@@ -57,3 +60,108 @@ TEST_CASE("pchunk with job info") {
     std::sort(ranges.begin(), ranges.end());
     CHECK(ranges == range_vec{{0, 5}, {5, 10}, {10, 15}, {15, 20}, {20, 23}});
 }
+
+TEST_CASE("pchunk uneven") {
+    // rounding up the chunk size leaves fewer chunks than jobs
+    par::thread_pool pool("test", 5);
+
+    std::mutex mtx;
+    range_vec ranges;
+    auto ret = par::pchunk(pool, {}, 9, [&](int begin, int end, par::job_info ji) {
+        CHECK(ji.num_jobs == 5);
+        std::lock_guard lock(mtx);
+        ranges.emplace_back(begin, end);
+    });
+    CHECK(ret == 5);
+    std::sort(ranges.begin(), ranges.end());
+    CHECK(ranges == range_vec{{0, 2}, {2, 4}, {4, 6}, {6, 8}, {8, 9}});
+}
+
+TEST_CASE("pchunk over-decomposed") {
+    static constexpr uint32_t num_threads = 3;
+    par::thread_pool pool("test", num_threads);
+
+    auto run_test = [&](par::run_opts opts, par::chunk_opts copts, int size, uint32_t expected_chunks, uint32_t expected_jobs) {
+        std::mutex mtx;
+        range_vec ranges;
+        std::vector<uint32_t> job_chunks(num_threads + 1);
+        auto ret = par::pchunk(pool, opts, copts, size, [&](int begin, int end, const par::job_info& ji) {
+            CHECK(ji.num_jobs == expected_jobs);
+            std::lock_guard lock(mtx);
+            REQUIRE(ji.job_index < ji.num_jobs);
+            ++job_chunks[ji.job_index];
+            ranges.emplace_back(begin, end);
+        });
+        CHECK(ret == expected_chunks);
+        REQUIRE(ranges.size() == expected_chunks);
+
+        std::sort(ranges.begin(), ranges.end());
+        int expected_begin = 0;
+        for (auto& [begin, end] : ranges) {
+            CHECK(begin == expected_begin);
+            CHECK(end > begin);
+            if (end - begin < int(copts.min_chunk_size)) {
+                CHECK(end == size); // only the last one may be smaller
+            }
+            expected_begin = end;
+        }
+        CHECK(expected_begin == size);
+
+        if (opts.sched == par::schedule_static) {
+            for (uint32_t j = 0; j < expected_jobs; ++j) {
+                CHECK(job_chunks[j] == expected_chunks / expected_jobs + (j < expected_chunks % expected_jobs));
+            }
+        }
+    };
+
+    for (auto sched : {par::schedule_dynamic, par::schedule_static}) {
+        run_test({.sched = sched}, {.chunks_per_job = 4}, 1000, 16, 4);
+        run_test({.sched = sched}, {.chunks_per_job = 4}, 10, 10, 4);
+        run_test({.sched = sched, .max_par = 2}, {.chunks_per_job = 8}, 1000, 16, 2);
+        run_test({.sched = sched}, {.chunks_per_job = 4, .min_chunk_size = 100}, 1000, 10, 4);
+        run_test({.sched = sched}, {.chunks_per_job = 4, .min_chunk_size = 300}, 1000, 3, 3);
+        run_test({.sched = sched}, {.min_chunk_size = 1000}, 999, 1, 1);
+        run_test({.sched = sched, .max_par = 1}, {.chunks_per_job = 3}, 100, 3, 1);
+    }
+}
+
+TEST_CASE("pchunk dynamic claiming") {
+    // a slow chunk doesn't hold up the others
+    par::thread_pool pool("test", 1);
+
+    std::atomic_bool slow_done = false;
+    std::atomic_int chunks_during_slow = 0;
+    par::pchunk(pool, {}, {.chunks_per_job = 8}, 16, [&](int begin, int) {
+        if (begin == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            slow_done = true;
+        }
+        else if (!slow_done) {
+            ++chunks_during_slow;
+        }
+    });
+    CHECK(chunks_during_slow == 15);
+}
+
+TEST_CASE("pchunk cancel") {
+    par::thread_pool pool("test", 3);
+
+    // cancelled tokens cancel all branches right away
+    par::cancellation_token token;
+    token.cancel();
+    std::atomic_int count = 0;
+    auto chunk = [&](int, int) { ++count; };
+    par::pchunk(pool, {.max_par = 1, .cancel = &token}, 100, chunk);
+    par::pchunk(pool, {.cancel = &token}, 100, chunk);
+    par::pchunk(pool, {.sched = par::schedule_static, .cancel = &token}, {.chunks_per_job = 4}, 100, chunk);
+    par::pchunk(pool, {.cancel = &token}, {.chunks_per_job = 4}, 100, chunk);
+    CHECK(count == 0);
+
+    // a single job stops after the chunk which cancels
+    par::cancellation_token token2;
+    par::pchunk(pool, {.max_par = 1, .cancel = &token2}, {.chunks_per_job = 10}, 100, [&](int begin, int) {
+        ++count;
+        if (begin == 30) token2.cancel();
+    });
+    CHECK(count == 4);
+}
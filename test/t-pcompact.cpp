@@ -0,0 +1,102 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/pcompact.hpp>
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+TEST_CASE("pcopy_if") {
+    par::thread_pool pool("test", 3);
+
+    for (size_t size : {0, 1, 63, 64, 65, 10'000, 100'003}) {
+        std::vector<int> data(size);
+        std::iota(data.begin(), data.end(), 0);
+
+        for (auto pred : {
+            +[](int i) { return i % 3 == 0; },
+            +[](int) { return true; },
+            +[](int) { return false; },
+            +[](int i) { return i < 5000; }
+        }) {
+            std::vector<int> expected;
+            std::copy_if(data.begin(), data.end(), std::back_inserter(expected), pred);
+
+            for (uint32_t max_par : {1, 4}) {
+                std::vector<int> out(size, -1);
+                auto end = par::pcopy_if(pool, {.max_par = max_par}, data.begin(), data.end(), out.begin(), pred);
+                REQUIRE(end - out.begin() == ptrdiff_t(expected.size()));
+                CHECK(std::equal(expected.begin(), expected.end(), out.begin()));
+                CHECK(std::all_of(end, out.end(), [](int v) { return v == -1; }));
+            }
+        }
+    }
+}
+
+TEST_CASE("premove_if") {
+    par::thread_pool pool("test", 3);
+
+    for (size_t size : {0, 1, 100, 100'003}) {
+        std::vector<std::unique_ptr<std::string>> data;
+        for (size_t i = 0; i < size; ++i) {
+            data.push_back(std::make_unique<std::string>(std::to_string(i)));
+        }
+
+        auto end = par::premove_if(pool, {}, data.begin(), data.end(), [](const std::unique_ptr<std::string>& s) {
+            return s->back() == '7';
+        });
+
+        size_t n = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (i % 10 == 7) continue;
+            REQUIRE(data[n]);
+            CHECK(*data[n] == std::to_string(i));
+            ++n;
+        }
+        CHECK(end - data.begin() == ptrdiff_t(n));
+    }
+}
+
+TEST_CASE("ppartition") {
+    par::thread_pool pool("test", 3);
+
+    for (size_t size : {0, 1, 100, 100'003}) {
+        std::vector<std::string> data;
+        for (size_t i = 0; i < size; ++i) {
+            data.push_back(std::to_string(i));
+        }
+        auto pred = [](const std::string& s) { return (s.back() - '0') % 2 == 0; };
+
+        auto expected = data;
+        auto expected_point = std::stable_partition(expected.begin(), expected.end(), pred);
+
+        for (auto sched : {par::schedule_dynamic, par::schedule_static}) {
+            auto d = data;
+            auto point = par::ppartition(pool, {.sched = sched}, d.begin(), d.end(), pred);
+            CHECK(point - d.begin() == expected_point - expected.begin());
+            CHECK(d == expected);
+        }
+    }
+}
+
+namespace {
+struct throwing_move {
+    throwing_move() = default;
+    throwing_move(throwing_move&&) noexcept(false) {}
+    throwing_move& operator=(throwing_move&&) noexcept(false) { return *this; }
+};
+
+template <typename T>
+concept removable = requires(std::vector<T>& v) {
+    par::premove_if(par::run_opts{}, v.begin(), v.end(), [](const T&) { return true; });
+    par::ppartition(par::run_opts{}, v.begin(), v.end(), [](const T&) { return true; });
+};
+} // namespace
+
+// the elements can't be restored if moving them throws
+static_assert(removable<std::string>);
+static_assert(removable<std::unique_ptr<int>>);
+static_assert(!removable<throwing_move>);
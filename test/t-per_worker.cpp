@@ -0,0 +1,137 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/per_worker.hpp>
+#include <par/pfor.hpp>
+#include <par/prun.hpp>
+#include <doctest/doctest.h>
+#include <atomic>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("current_worker_index") {
+    par::thread_pool pool("test", 3);
+    CHECK_FALSE(pool.current_worker_index());
+
+    std::vector<std::optional<uint32_t>> indices(4);
+    prun(pool, {.sched = par::schedule_static}, [&](uint32_t i) {
+        indices[i] = pool.current_worker_index();
+    });
+    CHECK_FALSE(indices[0]);
+    std::set<uint32_t> workers;
+    for (uint32_t i = 1; i < 4; ++i) {
+        REQUIRE(indices[i]);
+        workers.insert(*indices[i]);
+    }
+    CHECK(workers == std::set<uint32_t>{0, 1, 2});
+
+    par::thread_pool other("other", 1);
+    prun(pool, {.sched = par::schedule_static}, [&](uint32_t) {
+        CHECK_FALSE(other.current_worker_index());
+    });
+}
+
+TEST_CASE("per_worker") {
+    par::thread_pool pool("test", 3);
+
+    std::atomic_int num_inits = 0;
+    par::per_worker<std::vector<int>> pw(pool, [&](uint32_t slot) {
+        ++num_inits;
+        return std::vector<int>{int(slot) * 1000};
+    });
+
+    for (int r = 0; r < 100; ++r) {
+        par::pfor(pool, {}, 0, 100, [&](int i) {
+            pw.local().push_back(i);
+        });
+    }
+    CHECK(num_inits <= 4);
+
+    // all values are there exactly once
+    std::vector<int> counts(100);
+    std::set<int> slot_markers;
+    pw.for_each([&](std::vector<int>& v) {
+        REQUIRE(!v.empty());
+        slot_markers.insert(v.front());
+        for (size_t i = 1; i < v.size(); ++i) {
+            ++counts[v[i]];
+        }
+    });
+    CHECK(int(slot_markers.size()) == num_inits);
+    for (auto c : counts) {
+        CHECK(c == 100);
+    }
+
+    auto total = pw.combine(size_t(0), [](size_t sum, const std::vector<int>& v) {
+        return sum + v.size() - 1;
+    });
+    CHECK(total == 100 * 100);
+
+    pw.clear();
+    int n = 0;
+    pw.for_each([&](std::vector<int>&) { ++n; });
+    CHECK(n == 0);
+}
+
+TEST_CASE("per_worker multiple callers") {
+    par::thread_pool pool("test", 2);
+    par::per_worker<int> pw(pool);
+
+    auto run = [&]() {
+        for (int r = 0; r < 100; ++r) {
+            par::pfor(pool, {}, 0, 50, [&](int) {
+                ++pw.local();
+            });
+        }
+    };
+
+    std::thread a(run), b(run), c(run);
+    a.join();
+    b.join();
+    c.join();
+
+    CHECK(pw.combine(0, std::plus<int>{}) == 3 * 100 * 50);
+}
+
+TEST_CASE("per_worker init throws") {
+    par::thread_pool pool("test", 2);
+    bool fail = true;
+    par::per_worker<int> pw(pool, [&] {
+        if (fail) throw std::runtime_error("init");
+        return 1;
+    });
+
+    // the caller slot is taken by this thread
+    CHECK_THROWS_AS(pw.local(), std::runtime_error);
+
+    // other threads
+    std::thread([&] { CHECK_THROWS_AS(pw.local(), std::runtime_error); }).join();
+    CHECK(pw.combine(0, std::plus<int>{}) == 0);
+
+    fail = false;
+    std::thread([&] { CHECK(pw.local() == 1); }).join();
+    CHECK(pw.local() == 1);
+    CHECK(pw.combine(0, std::plus<int>{}) == 2);
+}
+
+TEST_CASE("per_worker slots of other threads") {
+    par::thread_pool pool("test", 2);
+    std::atomic_int num_inits = 0;
+    par::per_worker<int> pw(pool, [&] {
+        ++num_inits;
+        return 0;
+    });
+
+    // callers release their slots when their regions end, so threads which come later reuse them
+    for (int i = 0; i < 20; ++i) {
+        std::thread([&] {
+            par::pfor(pool, {}, 0, 50, [&](int) {
+                ++pw.local();
+            });
+        }).join();
+    }
+    CHECK(num_inits <= 3);
+    CHECK(pw.combine(0, std::plus<int>{}) == 20 * 50);
+}
@@ -0,0 +1,52 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/pfind.hpp>
+#include <doctest/doctest.h>
+#include <atomic>
+#include <vector>
+
+TEST_CASE("pfind_if") {
+    par::thread_pool pool("test", 4);
+
+    std::vector<int> data(100'000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = int(i % 1000);
+    }
+
+    for (uint32_t max_par : {1u, 2u, 0u}) {
+        par::run_opts opts{.max_par = max_par};
+
+        // lowest match, even when there are many
+        CHECK(par::pfind_if(pool, opts, 0, int(data.size()), [&](int i) { return data[i] == 999; }) == 999);
+        CHECK(par::pfind_if(pool, opts, size_t(0), data.size(), [&](size_t i) { return data[i] == 0; }) == 0);
+        CHECK(par::pfind_if(pool, opts, 50'000, 100'000, [&](int i) { return data[i] == 3; }) == 50'003);
+        CHECK(par::pfind_if(pool, opts, 0, int(data.size()), [&](int i) { return i == 99'999; }) == 99'999);
+        CHECK(par::pfind_if(pool, opts, 0, int(data.size()), [&](int i) { return data[i] < 0; }) == 100'000);
+        CHECK(par::pfind_if(pool, opts, -10, 10, [&](int i) { return i * i == 49; }) == -7);
+        CHECK(par::pfind_if(pool, opts, 5, 5, [&](int) { return true; }) == 5);
+
+        CHECK(par::pany_of(pool, opts, 0, int(data.size()), [&](int i) { return data[i] == 500; }));
+        CHECK_FALSE(par::pany_of(pool, opts, 0, int(data.size()), [&](int i) { return data[i] == 1000; }));
+        CHECK(par::pall_of(pool, opts, 0, int(data.size()), [&](int i) { return data[i] < 1000; }));
+        CHECK_FALSE(par::pall_of(pool, opts, 0, int(data.size()), [&](int i) { return data[i] < 999; }));
+    }
+
+    // other schedules are treated as dynamic
+    CHECK(par::pfind_if(pool, {.sched = par::schedule_static}, 0, 10'000, [](int i) { return i % 7 == 6; }) == 6);
+    CHECK(par::pfind_if(pool, {.sched = par::schedule_affinity}, 0, 10'000, [](int i) { return i % 7 == 6; }) == 6);
+    par::affinity_partitioner affinity;
+    CHECK(par::pfind_if(pool, {.sched = par::schedule_affinity, .affinity = &affinity}, 0, 10'000, [](int i) { return i % 7 == 6; }) == 6);
+}
+
+TEST_CASE("pfind_if early exit") {
+    par::thread_pool pool("test", 4);
+
+    std::atomic_int evaluated = 0;
+    auto f = par::pfind_if(pool, {}, 0, 1'000'000, [&](int i) {
+        ++evaluated;
+        return i == 1000;
+    });
+    CHECK(f == 1000);
+    CHECK(evaluated < 1'000'000);
+}
@@ -8,6 +8,8 @@
 #include <set>
 #include <algorithm>
 #include <mutex>
+#include <atomic>
+#include <chrono>
 
 TEST_CASE("pfor dynamic") {
     static constexpr uint32_t num_threads = 4;
@@ -215,3 +217,131 @@ TEST_CASE("pfor chunks") {
     });
 }
 
+
+TEST_CASE("pfor background") {
+    par::thread_pool pool("test", 3);
+
+    // background jobs yield to higher priority work, but all iterations are still executed exactly once
+    std::vector<std::atomic_int> hits(2000);
+    std::atomic_bool done = false;
+    std::thread high([&]() {
+        for (int n = 0; n < 1000 && !done; ++n) {
+            std::atomic_int count = 0;
+            par::pfor(pool, {.priority = par::priority_high}, 0, 10, [&](int) {
+                ++count;
+            });
+            CHECK(count == 10);
+        }
+    });
+
+    par::pfor(pool, {.priority = par::priority_background}, 0, int(hits.size()), [&](int i) {
+        ++hits[i];
+        std::this_thread::yield();
+    });
+    done = true;
+    high.join();
+
+    CHECK(std::all_of(hits.begin(), hits.end(), [](const std::atomic_int& h) { return h == 1; }));
+}
+
+TEST_CASE("pfor affinity") {
+    par::thread_pool pool("test", 3);
+    par::affinity_partitioner affinity;
+
+    // all iterations are executed exactly once, also when the partitioner is reused for different ranges
+    for (int size : {1000, 1000, 10, 1000, 1}) {
+        std::vector<std::atomic_int> hits(size);
+        par::pfor(pool, {.sched = par::schedule_affinity, .affinity = &affinity}, 0, size, [&](int i) {
+            ++hits[i];
+        });
+        CHECK(std::all_of(hits.begin(), hits.end(), [](const std::atomic_int& h) { return h == 1; }));
+    }
+
+    // without a partitioner it's the same as schedule_dynamic
+    std::atomic_int count = 0;
+    par::pfor(pool, {.sched = par::schedule_affinity}, 0, 1000, [&](int i) {
+        count += i;
+    });
+    CHECK(count == 500 * 999);
+}
+
+TEST_CASE("pfor affinity replay") {
+    par::thread_pool pool("test", 1);
+    par::affinity_partitioner affinity(4);
+
+    // 2 jobs with 4 blocks of 10 iterations each
+    static constexpr int size = 80;
+    std::vector<std::thread::id> prev(size), cur(size);
+
+    auto run = [&](std::vector<std::thread::id>& ids) {
+        // the first block of each thread waits for the other thread, so that no thread can steal blocks before the
+        // other one has started
+        std::atomic_int started = 0;
+        std::mutex mutex;
+        std::set<std::thread::id> seen;
+        par::pfor(pool, {.sched = par::schedule_affinity, .max_par = 2, .affinity = &affinity}, 0, size, [&](int i) {
+            const auto id = std::this_thread::get_id();
+            ids[i] = id;
+            if (i % 10 != 0) return;
+            {
+                std::lock_guard lock(mutex);
+                if (!seen.insert(id).second) return;
+            }
+            ++started;
+            const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (started < 2 && std::chrono::steady_clock::now() < timeout) {
+                std::this_thread::yield();
+            }
+        });
+        return std::set<std::thread::id>(ids.begin(), ids.end()).size();
+    };
+
+    REQUIRE(run(prev) == 2);
+    for (int n = 0; n < 10; ++n) {
+        REQUIRE(run(cur) == 2);
+
+        // each thread starts with its own blocks from the previous loop, which the other one can't steal before it
+        // has started
+        std::set<std::thread::id> first_own;
+        for (int b = 0; b < size; b += 10) {
+            if (cur[b] == prev[b]) first_own.insert(cur[b]);
+        }
+        CHECK(first_own.size() == 2);
+        std::swap(prev, cur);
+    }
+}
+
+TEST_CASE("pfor cancel") {
+    par::thread_pool pool("test", 4);
+
+    auto run_test = [&](par::run_opts opts) {
+        par::cancellation_token token;
+        opts.cancel = &token;
+        std::vector<std::atomic_int> hits(10'000);
+        par::pfor(pool, opts, 0, int(hits.size()), [&](int i) {
+            ++hits[i];
+            if (i == 100) token.cancel();
+        });
+        CHECK(token.cancelled());
+        CHECK(hits[100] == 1);
+        int total = 0;
+        for (auto& h : hits) {
+            CHECK(h <= 1);
+            total += h;
+        }
+        CHECK(total < int(hits.size()));
+        return total;
+    };
+
+    CHECK(run_test({.max_par = 1}) == 101);
+    run_test({});
+    run_test({.sched = par::schedule_static});
+
+    // cancelled tokens cancel loops right away
+    par::cancellation_token token;
+    token.cancel();
+    int count = 0;
+    par::pfor(pool, {.cancel = &token}, 0, 100, [&](int) { ++count; });
+    par::pfor(pool, {.cancel = &token}, par::range(0, 100).job_chunk(10), [&](int) { ++count; });
+    CHECK(count == 0);
+}
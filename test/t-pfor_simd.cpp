@@ -0,0 +1,69 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/pfor_simd.hpp>
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <vector>
+
+template <size_t W, size_t ChunkAlign>
+void check_pfor_simd(par::thread_pool& pool, par::run_opts opts, int begin, int end) {
+    std::vector<std::atomic_int> counts(std::max(end - begin, 0));
+    std::atomic_int num_bad_blocks = 0;
+    par::pfor_simd<W, ChunkAlign>(pool, opts, begin, end,
+        [&](par::simd_block<W, int> b) {
+            if (b.first % int(W) != 0) ++num_bad_blocks;
+            for (size_t l = 0; l < W; ++l) {
+                ++counts[b[l] - begin];
+            }
+        },
+        [&](int i) {
+            ++counts[i - begin];
+        }
+    );
+    CHECK(num_bad_blocks == 0);
+    for (auto& c : counts) {
+        CHECK(c == 1);
+    }
+}
+
+TEST_CASE("pfor_simd") {
+    par::thread_pool pool("test", 3);
+
+    for (auto sched : {par::schedule_dynamic, par::schedule_static}) {
+        for (uint32_t max_par : {1, 2, 4}) {
+            const par::run_opts opts{.sched = sched, .max_par = max_par};
+            for (auto [b, e] : {std::pair{0, 1000}, {3, 5}, {1, 9}, {-13, 250}, {7, 7}, {5, 2}}) {
+                check_pfor_simd<4, 4>(pool, opts, b, e);
+                check_pfor_simd<8, 32>(pool, opts, b, e);
+                check_pfor_simd<1, 16>(pool, opts, b, e);
+            }
+        }
+    }
+}
+
+TEST_CASE("pfor_simd chunk alignment") {
+    par::thread_pool pool("test", 3);
+
+    // jobs get ranges which start at multiples of ChunkAlign
+    for (auto sched : {par::schedule_dynamic, par::schedule_static}) {
+        std::mutex mutex;
+        std::set<std::pair<uint32_t, int>> job_blocks;
+        par::pfor_simd<4, 16>(pool, {.sched = sched}, 2, 1001,
+            [&](par::simd_block<4, int> b, par::job_info& ji) {
+                std::lock_guard lock(mutex);
+                job_blocks.insert({ji.job_index, b.first});
+            },
+            [](int) {}
+        );
+        REQUIRE(job_blocks.size() == 249);
+        for (auto& [ji, first] : job_blocks) {
+            // if the previous block in the same chunk was done by another job, the chunk is split
+            if (first % 16 == 0 || first == 4) continue;
+            CHECK(job_blocks.count({ji, first - 4}) == 1);
+        }
+    }
+}
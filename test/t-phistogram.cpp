@@ -0,0 +1,82 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/phistogram.hpp>
+#include <par/prun.hpp>
+#include <doctest/doctest.h>
+#include <atomic>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace {
+uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+} // namespace
+
+TEST_CASE("phistogram") {
+    par::thread_pool pool("test", 3);
+
+    for (size_t num_bins : {1, 16, 1000, 100'000}) {
+        for (int size : {0, 1, 10, 50'000}) {
+            // uniform, skewed, and with ignored values
+            auto uniform = [&](int i) { return hash(i) % num_bins; };
+            auto skewed = [&](int i) { auto h = hash(i); return h % 4 ? 0 : h % num_bins; };
+            auto filtered = [&](int i) { return i % 3 ? int(hash(i) % num_bins) : -1; };
+
+            auto check = [&](auto bin_func) {
+                std::vector<uint64_t> expected(num_bins);
+                for (int i = 0; i < size; ++i) {
+                    const auto b = size_t(bin_func(i));
+                    if (b < num_bins) ++expected[b];
+                }
+                for (auto strategy : {par::histogram_auto, par::histogram_private, par::histogram_atomic, par::histogram_hybrid}) {
+                    for (uint32_t max_par : {1, 4}) {
+                        auto h = par::phistogram(pool, {.max_par = max_par}, 0, size, num_bins, bin_func, strategy);
+                        CHECK(h == expected);
+                    }
+                }
+            };
+
+            check(uniform);
+            check(skewed);
+            check(filtered);
+        }
+    }
+}
+
+TEST_CASE("phistogram accumulate") {
+    par::thread_pool pool("test", 2);
+
+    std::vector<uint32_t> bins(10, 1);
+    par::phistogram(pool, {}, 0, 1000, std::span(bins), [](int i) { return i % 10; });
+    for (auto b : bins) {
+        CHECK(b == 101);
+    }
+}
+
+TEST_CASE("phistogram nesting") {
+    static constexpr uint32_t num_threads = 2;
+    par::thread_pool pool("test", num_threads);
+
+    std::atomic_int32_t throws = 0;
+    std::atomic_int32_t local = 0;
+    par::prun(pool, {}, [&](uint32_t) {
+        try {
+            auto h = par::phistogram(pool, {.sched = par::schedule_static}, 0, 100, 10, [](int i) { return i % 10; });
+            if (h == std::vector<uint64_t>(10, 10)) ++local;
+        }
+        catch (const std::runtime_error& err) {
+            CHECK(std::string_view(err.what()) == "unsupported nested par call");
+            ++throws;
+        }
+    });
+    CHECK(local == 1);
+    CHECK(throws == num_threads);
+}
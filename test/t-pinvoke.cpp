@@ -0,0 +1,84 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/pinvoke.hpp>
+#include <doctest/doctest.h>
+#include <atomic>
+#include <latch>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("pinvoke") {
+    par::thread_pool pool("test", 3);
+
+    // different callables, including a non-copyable one and an lvalue
+    int a = 0;
+    std::string b;
+    std::vector<int> c;
+    auto unique = std::make_unique<int>(5);
+    auto fc = [&]() { c.assign(100, 7); };
+    std::thread::id first_thread;
+    par::pinvoke(pool, {},
+        [&]() { a = 42; first_thread = std::this_thread::get_id(); },
+        [&]() { b = "hello"; },
+        fc,
+        [u = std::move(unique)]() { CHECK(*u == 5); }
+    );
+    CHECK(a == 42);
+    CHECK(b == "hello");
+    CHECK(c == std::vector<int>(100, 7));
+    CHECK(first_thread == std::this_thread::get_id()); // the caller runs the first one
+
+    // nothing and one
+    par::pinvoke(pool, {});
+    int one = 0;
+    par::pinvoke(pool, {}, [&]() { ++one; });
+    CHECK(one == 1);
+}
+
+TEST_CASE("pinvoke concurrency") {
+    par::thread_pool pool("test", 3);
+
+    // as many functions as threads run concurrently
+    std::latch all(4);
+    auto f = [&]() { all.arrive_and_wait(); };
+    par::pinvoke(pool, {}, f, f, f, f);
+
+    // more functions than jobs are claimed by the jobs which finish first
+    for (uint32_t max_par : {1, 2, 4}) {
+        std::atomic_uint32_t calls = 0;
+        std::atomic_uint32_t mask = 0;
+        auto g = [&](uint32_t bit) {
+            return [&, bit]() { ++calls; mask |= 1 << bit; };
+        };
+        par::pinvoke(pool, {.max_par = max_par}, g(0), g(1), g(2), g(3), g(4), g(5), g(6), g(7));
+        CHECK(calls == 8);
+        CHECK(mask == 0xFF);
+    }
+
+    // static scheduling
+    std::atomic_uint32_t calls = 0;
+    auto h = [&]() { ++calls; };
+    par::pinvoke(pool, {.sched = par::schedule_static}, h, h, h, h, h);
+    CHECK(calls == 5);
+}
+
+TEST_CASE("pinvoke nested") {
+    par::thread_pool pool("test", 3);
+    std::atomic_uint32_t calls = 0;
+    auto leaf = [&]() { ++calls; };
+    auto inner = [&]() { par::pinvoke(pool, {}, leaf, leaf, leaf); };
+    par::pinvoke(pool, {}, inner, inner, inner);
+    CHECK(calls == 9);
+}
+
+TEST_CASE("pinvoke cancel") {
+    par::thread_pool pool("test", 3);
+    par::cancellation_token token;
+    std::atomic_uint32_t calls = 0;
+    auto f = [&]() { ++calls; token.cancel(); };
+    par::pinvoke(pool, {.max_par = 1, .cancel = &token}, f, f, f);
+    CHECK(calls == 1);
+}
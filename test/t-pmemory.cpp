@@ -0,0 +1,107 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/pmemory.hpp>
+#include <par/pfor.hpp>
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+struct vec3 {
+    float x, y, z;
+    bool operator==(const vec3&) const = default;
+};
+} // namespace
+
+TEST_CASE("pallocate") {
+    par::thread_pool pool("test", 3);
+
+    for (size_t size : {0, 1, 1000, 1'000'003}) {
+        auto buf = par::pallocate<uint32_t>(pool, {}, size);
+        CHECK(uintptr_t(buf.get()) % par::cpu::cache_line_size == 0);
+        CHECK(std::all_of(buf.get(), buf.get() + size, [](uint32_t v) { return v == 0; }));
+    }
+
+    auto big = par::pallocate<double>(pool, {.max_par = 2}, par::impl::huge_page_size);
+    CHECK(uintptr_t(big.get()) % par::impl::huge_page_size == 0);
+    CHECK(std::all_of(big.get(), big.get() + par::impl::huge_page_size, [](double v) { return v == 0; }));
+}
+
+TEST_CASE("pinit") {
+    par::thread_pool pool("test", 3);
+
+    for (size_t size : {0, 1, 1000, 1'000'003}) {
+        auto buf = par::pinit<vec3>(pool, {}, size, [](size_t i) {
+            return vec3{float(i), 1, 2};
+        });
+        bool ok = true;
+        for (size_t i = 0; i < size; ++i) {
+            ok = ok && buf[i] == vec3{float(i), 1, 2};
+        }
+        CHECK(ok);
+    }
+}
+
+TEST_CASE("first touch partition") {
+    // the elements are initialized by the threads which later run the same indices in a static pfor
+    par::thread_pool pool("test", 3);
+    const size_t size = 100'003;
+
+    auto owners = par::pinit<std::thread::id>(pool, {}, size, [](size_t) {
+        return std::this_thread::get_id();
+    });
+
+    std::atomic_uint32_t mismatches = 0;
+    par::pfor(pool, {.sched = par::schedule_static}, size_t(0), size, [&](size_t i) {
+        if (owners[i] != std::this_thread::get_id()) ++mismatches;
+    });
+    CHECK(mismatches == 0);
+}
+
+template <typename T>
+void test_fill_copy(par::thread_pool& pool, T a, T b) {
+    // large enough for non-temporal stores, at offsets which are not 16-byte aligned
+    const size_t big = par::impl::stream_store_min_size / sizeof(T) + 77;
+    for (size_t size : {size_t(0), size_t(1), size_t(1000), big}) {
+        for (size_t offset : {0, 1, 3}) {
+            std::vector<T> data(size + offset + 1, b);
+            par::pfill(pool, {}, data.data() + offset, size, a);
+            CHECK(std::all_of(data.begin(), data.begin() + offset, [&](const T& v) { return v == b; }));
+            CHECK(std::all_of(data.begin() + offset, data.begin() + offset + size, [&](const T& v) { return v == a; }));
+            CHECK(data.back() == b);
+
+            std::vector<T> src(size);
+            for (size_t i = 0; i < size; ++i) {
+                src[i] = i % 2 ? a : b;
+            }
+            std::vector<T> dst(size + offset + 1, b);
+            par::pcopy(pool, {.max_par = 3}, src.data(), size, dst.data() + offset);
+            CHECK(std::equal(src.begin(), src.end(), dst.begin() + offset));
+            CHECK(dst.back() == b);
+        }
+    }
+}
+
+TEST_CASE("pfill and pcopy") {
+    par::thread_pool pool("test", 3);
+    test_fill_copy<uint8_t>(pool, 1, 2);
+    test_fill_copy<uint16_t>(pool, 0x1234, 0x4321);
+    test_fill_copy<float>(pool, 1.5f, -2.f);
+    test_fill_copy<uint64_t>(pool, 0x0123'4567'89AB'CDEF, 7);
+    test_fill_copy<vec3>(pool, {1, 2, 3}, {4, 5, 6});
+}
+
+TEST_CASE("nested") {
+    par::thread_pool pool("test", 3);
+    std::atomic_uint32_t bad = 0;
+    par::pfor(pool, {}, 0, 4, [&](int) {
+        auto buf = par::pallocate<int>(pool, {}, 1000);
+        par::pfill(pool, {}, buf.get(), 1000, 5);
+        if (!std::all_of(buf.get(), buf.get() + 1000, [](int v) { return v == 5; })) ++bad;
+    });
+    CHECK(bad == 0);
+}
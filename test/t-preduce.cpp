@@ -0,0 +1,82 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/preduce.hpp>
+#include <doctest/doctest.h>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+TEST_CASE("preduce") {
+    par::thread_pool pool("test", 3);
+
+    for (bool det : {false, true}) {
+        const par::reduce_opts ropts{.deterministic = det, .block_size = 7};
+        auto sum = par::preduce(pool, {}, ropts, 0, 1000, 5, [](int i) { return i; }, std::plus<int>{});
+        CHECK(sum == 5 + 500 * 999);
+
+        auto empty = par::preduce(pool, {}, ropts, 3, 3, 42, [](int i) { return i; }, std::plus<int>{});
+        CHECK(empty == 42);
+
+        // order is preserved
+        auto str = par::preduce(pool, {}, ropts, 0, 200, std::string(">"),
+            [](int i) { return std::string(1, char('a' + i % 26)); },
+            [](std::string a, const std::string& b) { return a + b; }
+        );
+        REQUIRE(str.size() == 201);
+        CHECK(str[0] == '>');
+        for (int i = 0; i < 200; ++i) {
+            CHECK(str[i + 1] == char('a' + i % 26));
+        }
+
+        // move-only values
+        auto ptr = par::preduce(pool, {}, ropts, 0, 100, std::make_unique<int>(0),
+            [](int i) { return std::make_unique<int>(i); },
+            [](std::unique_ptr<int> a, std::unique_ptr<int> b) { *a += *b; return a; }
+        );
+        CHECK(*ptr == 50 * 99);
+    }
+}
+
+TEST_CASE("preduce deterministic") {
+    // values of very different magnitudes, so that the sum depends on the order of additions
+    std::vector<double> data(100'003);
+    uint64_t h = 1;
+    for (auto& d : data) {
+        h = h * 6364136223846793005ull + 1442695040888963407ull;
+        d = double(h >> 11) * std::ldexp(1.0, int(h % 64) - 32 - 53);
+    }
+
+    auto reduce = [&](par::thread_pool& pool, par::run_opts opts, bool det) {
+        return par::preduce(pool, opts, {.deterministic = det}, size_t(0), data.size(), 0.0,
+            [&](size_t i) { return data[i]; }, std::plus<double>{}
+        );
+    };
+
+    auto bits = [](double d) {
+        uint64_t b;
+        std::memcpy(&b, &d, sizeof(b));
+        return b;
+    };
+
+    par::thread_pool single("single", 0);
+    const auto reference = reduce(single, {}, true);
+
+    bool fast_differs = false;
+    for (uint32_t num_threads : {1, 2, 3, 5, 8}) {
+        par::thread_pool pool("test", num_threads);
+        for (uint32_t max_par : {0, 1, 2, 3, 4}) {
+            for (auto sched : {par::schedule_dynamic, par::schedule_static}) {
+                const par::run_opts opts{.sched = sched, .max_par = max_par};
+                CHECK(bits(reduce(pool, opts, true)) == bits(reference));
+                fast_differs |= bits(reduce(pool, opts, false)) != bits(reference);
+            }
+        }
+    }
+
+    // not guaranteed, but with these values the default mode should be sensitive to the partitioning
+    CHECK(fast_differs);
+}
@@ -0,0 +1,149 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/pwavefront.hpp>
+#include <par/pfor.hpp>
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+// every tile runs once, after its dependencies
+uint32_t check_order(par::thread_pool& pool, par::run_opts opts, uint32_t rows, uint32_t cols) {
+    std::vector<std::atomic_uint32_t> runs(rows * cols);
+    std::atomic_uint32_t bad = 0;
+    par::pwavefront(pool, opts, rows, cols, [&](uint32_t i, uint32_t j) {
+        if (i > 0 && runs[(i - 1) * cols + j].load() != 1) ++bad;
+        if (j > 0 && runs[i * cols + j - 1].load() != 1) ++bad;
+        ++runs[i * cols + j];
+    });
+    for (auto& r : runs) {
+        if (r != 1) ++bad;
+    }
+    return bad;
+}
+
+uint32_t edit_distance_serial(const std::string& a, const std::string& b) {
+    std::vector<uint32_t> d((a.size() + 1) * (b.size() + 1));
+    const auto w = b.size() + 1;
+    for (size_t i = 0; i <= a.size(); ++i) {
+        for (size_t j = 0; j <= b.size(); ++j) {
+            if (i == 0 || j == 0) {
+                d[i * w + j] = uint32_t(i + j);
+                continue;
+            }
+            d[i * w + j] = std::min({
+                d[(i - 1) * w + j] + 1,
+                d[i * w + j - 1] + 1,
+                d[(i - 1) * w + j - 1] + (a[i - 1] != b[j - 1]),
+            });
+        }
+    }
+    return d.back();
+}
+
+std::string make_string(size_t size, uint32_t seed) {
+    std::string ret(size, 'a');
+    for (auto& c : ret) {
+        seed = seed * 1664525 + 1013904223;
+        c = char('a' + (seed >> 28) % 4);
+    }
+    return ret;
+}
+} // namespace
+
+TEST_CASE("order") {
+    par::thread_pool pool("test", 3);
+    for (uint32_t rows : {1, 2, 7, 30}) {
+        for (uint32_t cols : {1, 3, 30}) {
+            CHECK(check_order(pool, {}, rows, cols) == 0);
+            CHECK(check_order(pool, {.max_par = 2}, rows, cols) == 0);
+            CHECK(check_order(pool, {.sched = par::schedule_static}, rows, cols) == 0);
+        }
+    }
+
+    int calls = 0;
+    par::pwavefront(pool, {}, 0, 10, [&](uint32_t, uint32_t) { ++calls; });
+    par::pwavefront(pool, {}, 10, 0, [&](uint32_t, uint32_t) { ++calls; });
+    CHECK(calls == 0);
+}
+
+TEST_CASE("edit distance") {
+    par::thread_pool pool("test", 3);
+    const auto a = make_string(1000, 1);
+    const auto b = make_string(777, 2);
+    const auto w = b.size() + 1;
+    const uint32_t tile = 64;
+
+    std::vector<uint32_t> d((a.size() + 1) * w);
+    const auto tile_rows = uint32_t((a.size() + tile) / tile);
+    const auto tile_cols = uint32_t((b.size() + tile) / tile);
+    std::atomic_uint32_t max_jobs = 0;
+    par::pwavefront(pool, {}, tile_rows, tile_cols, [&](uint32_t ti, uint32_t tj, const par::job_info& ji) {
+        max_jobs = std::max(max_jobs.load(), ji.num_jobs);
+        const size_t iend = std::min(a.size() + 1, size_t(ti + 1) * tile);
+        const size_t jend = std::min(w, size_t(tj + 1) * tile);
+        for (size_t i = ti * tile; i < iend; ++i) {
+            for (size_t j = tj * tile; j < jend; ++j) {
+                if (i == 0 || j == 0) {
+                    d[i * w + j] = uint32_t(i + j);
+                    continue;
+                }
+                d[i * w + j] = std::min({
+                    d[(i - 1) * w + j] + 1,
+                    d[i * w + j - 1] + 1,
+                    d[(i - 1) * w + j - 1] + (a[i - 1] != b[j - 1]),
+                });
+            }
+        }
+    });
+    CHECK(d.back() == edit_distance_serial(a, b));
+    CHECK(max_jobs == 4);
+}
+
+TEST_CASE("nested") {
+    par::thread_pool pool("test", 3);
+    std::atomic_uint32_t bad = 0;
+    par::pfor(pool, {}, 0, 4, [&](int) {
+        bad += check_order(pool, {}, 10, 10);
+    });
+    CHECK(bad == 0);
+}
+
+TEST_CASE("cancel and exceptions") {
+    par::thread_pool pool("test", 3);
+    for (uint32_t max_par : {1, 0}) {
+        par::cancellation_token token;
+        std::atomic_uint32_t calls = 0;
+        par::pwavefront(pool, {.max_par = max_par, .cancel = &token}, 20, 20, [&](uint32_t i, uint32_t j) {
+            ++calls;
+            if (i == 5 && j == 5) token.cancel();
+        });
+        CHECK(calls < 400);
+    }
+
+    // on the caller thread
+    std::atomic_uint32_t calls = 0;
+    CHECK_THROWS_AS(par::pwavefront(pool, {.max_par = 1}, 20, 20, [&](uint32_t i, uint32_t) {
+        ++calls;
+        if (i == 3) throw std::runtime_error("tile");
+    }), std::runtime_error);
+    CHECK(calls == 61);
+
+    // on any thread, also the first tile, whose job the others wait for
+    for (uint32_t row : {0, 10}) {
+        calls = 0;
+        CHECK_THROWS_AS(par::pwavefront(pool, {.max_par = 0}, 20, 20, [&](uint32_t i, uint32_t) {
+            ++calls;
+            if (i == row) throw std::runtime_error("tile");
+        }), std::runtime_error);
+        CHECK(calls < 400);
+    }
+
+    // the pool is still usable
+    CHECK(check_order(pool, {}, 10, 10) == 0);
+}
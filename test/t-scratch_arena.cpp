@@ -0,0 +1,95 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/scratch_arena.hpp>
+#include <par/pfor.hpp>
+#include <par/prun.hpp>
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+TEST_CASE("scratch_arena") {
+    par::scratch_arena arena;
+    CHECK(arena.capacity() == 0);
+
+    auto a = arena.allocate(10);
+    CHECK(arena.capacity() == par::scratch_arena::initial_block_size);
+    CHECK(reinterpret_cast<uintptr_t>(a) % alignof(std::max_align_t) == 0);
+
+    auto b = arena.allocate(3, 1);
+    CHECK(b == static_cast<std::byte*>(a) + 10);
+
+    auto c = arena.allocate<double>(5);
+    CHECK(reinterpret_cast<uintptr_t>(c) % alignof(double) == 0);
+
+    auto d = arena.allocate(100, 256);
+    CHECK(reinterpret_cast<uintptr_t>(d) % 256 == 0);
+
+    const auto m = arena.mark();
+
+    // geometric growth
+    arena.allocate(par::scratch_arena::initial_block_size);
+    CHECK(arena.capacity() == 3 * par::scratch_arena::initial_block_size);
+    auto big = arena.allocate(10 * par::scratch_arena::initial_block_size);
+    CHECK(arena.capacity() > 13 * par::scratch_arena::initial_block_size);
+    std::memset(big, 0xAB, 10 * par::scratch_arena::initial_block_size);
+
+    // memory is reused after rewinds
+    size_t cap = 0;
+    for (int i = 0; i < 100; ++i) {
+        par::scratch_arena::scope scope(arena);
+        auto e = arena.allocate(par::scratch_arena::initial_block_size);
+        std::memset(e, i, par::scratch_arena::initial_block_size);
+        if (i == 0) cap = arena.capacity();
+        CHECK(arena.capacity() == cap);
+    }
+
+    arena.rewind(m);
+    CHECK(arena.allocate(1, 1) == static_cast<std::byte*>(d) + 100);
+    CHECK(arena.capacity() == cap);
+}
+
+TEST_CASE("scratch in jobs") {
+    par::thread_pool pool("test", 4);
+    static constexpr int size = 4096;
+
+    struct job_data {
+        int* buf;
+        int count = 0;
+        job_data(const par::job_info& info)
+            : buf(info.scratch().allocate<int>(size))
+        {}
+    };
+
+    for (int r = 0; r < 1000; ++r) {
+        std::atomic_int sum = 0;
+        par::pfor<job_data>(pool, {}, 0, 64, [&](int i, job_data& data) {
+            // concurrent jobs don't share scratch memory
+            data.buf[data.count++] = i;
+            par::scratch_arena::scope iteration_scope;
+            auto tmp = par::scratch_arena::current().allocate<int>(size);
+            std::fill(tmp, tmp + size, i);
+            for (int j = 0; j < data.count; ++j) {
+                sum += data.buf[j];
+            }
+            sum -= std::count(tmp, tmp + size, i) == size ? 0 : 1'000'000;
+            data.count = 0;
+        });
+        CHECK(sum == 63 * 32);
+    }
+
+    // memory is released at the end of each job and never grows
+    std::vector<size_t> capacities(pool.max_parallel_jobs());
+    prun(pool, {.sched = par::schedule_static}, [&](uint32_t i) {
+        capacities[i] = par::scratch_arena::current().capacity();
+    });
+    for (auto c : capacities) {
+        CHECK(c <= par::scratch_arena::initial_block_size);
+    }
+
+    // single job path
+    par::pfor<job_data>(pool, {.max_par = 1}, 0, 10, [&](int, job_data&) {});
+    CHECK(par::scratch_arena::current().mark().offset == 0);
+}
@@ -0,0 +1,143 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/task_group.hpp>
+#include <par/pfor.hpp>
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+uint64_t fib(par::thread_pool& pool, uint32_t n) {
+    if (n < 2) return n;
+    uint64_t a = 0, b = 0;
+    par::task_group g(pool);
+    g.spawn([&]() { a = fib(pool, n - 1); });
+    b = fib(pool, n - 2);
+    g.wait();
+    return a + b;
+}
+
+void quicksort(par::task_group& g, int* begin, int* end) {
+    while (end - begin > 32) {
+        const int pivot = begin[(end - begin) / 2];
+        int* mid1 = std::partition(begin, end, [&](int v) { return v < pivot; });
+        int* mid2 = std::partition(mid1, end, [&](int v) { return v == pivot; });
+        g.spawn([&g, begin, mid1]() { quicksort(g, begin, mid1); });
+        begin = mid2;
+    }
+    std::sort(begin, end);
+}
+} // namespace
+
+TEST_CASE("fib") {
+    par::thread_pool pool("test", 3);
+    CHECK(fib(pool, 20) == 6765);
+
+    par::thread_pool none("none", 0);
+    CHECK(fib(none, 15) == 610);
+}
+
+TEST_CASE("quicksort") {
+    par::thread_pool pool("test", 3);
+    std::minstd_rand rng(123);
+    std::vector<int> data(100'003);
+    for (auto& v : data) {
+        v = int(rng() % 10'000);
+    }
+    auto sorted = data;
+    std::sort(sorted.begin(), sorted.end());
+
+    // all tasks in one group, spawned by other tasks
+    par::task_group g(pool);
+    quicksort(g, data.data(), data.data() + data.size());
+    g.wait();
+    CHECK(g.num_pending() == 0);
+    CHECK(data == sorted);
+}
+
+TEST_CASE("reuse") {
+    par::thread_pool pool("test", 3);
+    par::task_group g(pool);
+    std::atomic_uint32_t sum = 0;
+    for (uint32_t i = 0; i < 10; ++i) {
+        for (uint32_t j = 0; j < 100; ++j) {
+            g.spawn([&, j]() { sum += j; });
+        }
+        g.wait();
+        CHECK(sum == (i + 1) * 4950);
+    }
+
+    // the destructor waits
+    {
+        par::task_group g2(pool);
+        for (uint32_t j = 0; j < 100; ++j) {
+            g2.spawn([&]() { ++sum; });
+        }
+    }
+    CHECK(sum == 10 * 4950 + 100);
+}
+
+TEST_CASE("in par calls") {
+    par::thread_pool pool("test", 3);
+    std::atomic_uint32_t count = 0;
+    par::pfor(pool, {}, 0, 8, [&](int) {
+        par::task_group g(pool);
+        for (int i = 0; i < 10; ++i) {
+            g.spawn([&]() {
+                par::task_group inner(pool);
+                inner.spawn([&]() { ++count; });
+                inner.spawn([&]() { ++count; });
+            });
+        }
+    });
+    CHECK(count == 160);
+}
+
+TEST_CASE("exceptions") {
+    par::thread_pool none("none", 0);
+    par::task_group g(none);
+    bool after = false;
+    g.spawn([&]() { after = true; });
+    g.spawn([]() { throw std::runtime_error("task"); });
+    CHECK_THROWS_AS(g.wait(), std::runtime_error);
+
+    // the group is still usable
+    g.wait();
+    CHECK(after);
+    CHECK(g.num_pending() == 0);
+
+    // a wait for another group runs the task, but doesn't throw
+    par::task_group other(none);
+    other.spawn([&]() { after = false; });
+    g.spawn([]() { throw std::runtime_error("task"); });
+    other.wait();
+    CHECK_FALSE(after);
+    CHECK_THROWS_AS(g.wait(), std::runtime_error);
+
+    // dropped if no one waits
+    {
+        par::task_group dropped(none);
+        dropped.spawn([]() { throw std::runtime_error("task"); });
+    }
+}
+
+TEST_CASE("exceptions on workers") {
+    par::thread_pool pool("test", 3);
+    par::task_group g(pool);
+    std::atomic_int count = 0;
+    for (int i = 0; i < 100; ++i) {
+        g.spawn([&, i]() {
+            ++count;
+            if (i % 10 == 0) throw std::runtime_error("task");
+        });
+    }
+    CHECK_THROWS_AS(g.wait(), std::runtime_error);
+    CHECK(count == 100);
+    g.wait();
+}
@@ -0,0 +1,154 @@
+// Copyright (c) Borislav Stanimirov
+// SPDX-License-Identifier: MIT
+//
+#include <par/team.hpp>
+#include <par/prun.hpp>
+#include <doctest/doctest.h>
+#include <vector>
+#include <thread>
+#include <set>
+#include <mutex>
+#include <string_view>
+
+TEST_CASE("team loops") {
+    static constexpr uint32_t num_threads = 4;
+    static constexpr uint32_t num_jobs = num_threads + 1;
+    par::thread_pool pool("test", num_threads);
+
+    static constexpr int size = 1000;
+    std::vector<int> a(size, -1), b(size, -1), c(size, -1);
+
+    auto ret = par::pteam(pool, {}, [&](par::team& t) {
+        CHECK(t.num_jobs() == num_jobs);
+        t.pfor(0, size, [&](int i) {
+            a[i] = i;
+        });
+        // reads elements written by other jobs, requires the implicit barrier
+        t.pfor({.sched = par::schedule_dynamic}, 0, size, [&](int i) {
+            b[i] = a[size - 1 - i];
+        });
+        t.pfor({.nowait = true}, 0, size, [&](int i) {
+            c[i] = b[i] * 2;
+        });
+        t.barrier();
+        t.single([&]() {
+            for (int i = 0; i < size; ++i) {
+                CHECK(c[i] == (size - 1 - i) * 2);
+            }
+        });
+    });
+    CHECK(ret == num_jobs);
+
+    for (int i = 0; i < size; ++i) {
+        CHECK(a[i] == i);
+        CHECK(b[i] == size - 1 - i);
+    }
+}
+
+TEST_CASE("team static affinity") {
+    static constexpr uint32_t num_threads = 4;
+    par::thread_pool pool("test", num_threads);
+
+    static constexpr size_t size = 100;
+    std::vector<std::thread::id> a(size), b(size);
+
+    par::pteam(pool, {.max_par = 3}, [&](par::team& t) {
+        CHECK(t.num_jobs() == 3);
+        t.pfor(size_t(0), size, [&](size_t i) {
+            a[i] = std::this_thread::get_id();
+        });
+        t.pfor(size_t(0), size, [&](size_t i) {
+            b[i] = std::this_thread::get_id();
+        });
+    });
+
+    // same partition, same threads
+    CHECK(a == b);
+    std::set<std::thread::id> unique_ids(a.begin(), a.end());
+    CHECK(unique_ids.size() == 3);
+}
+
+TEST_CASE("team job data") {
+    static constexpr uint32_t num_threads = 4;
+    par::thread_pool pool("test", num_threads);
+
+    struct job_data : public par::job_info {
+        job_data(const par::job_info& ji) : par::job_info(ji) {}
+        int loops = 0;
+        int iterations = 0;
+    };
+
+    std::mutex mtx;
+    int total_iterations = 0;
+    par::pteam<job_data>(pool, {}, [&](par::team& t, job_data& jd) {
+        CHECK(jd.job_index == t.job_index());
+        for (int step = 0; step < 10; ++step) {
+            t.pfor({.sched = step % 2 ? par::schedule_dynamic : par::schedule_static}, 0, 20, [&](int) {
+                ++jd.iterations;
+            });
+            ++jd.loops;
+        }
+        CHECK(jd.loops == 10);
+        std::lock_guard lock(mtx);
+        total_iterations += jd.iterations;
+    });
+    CHECK(total_iterations == 200);
+}
+
+TEST_CASE("team single-thread") {
+    auto caller_tid = std::this_thread::get_id();
+    par::thread_pool pool("test", 4);
+
+    int sum = 0;
+    auto ret = par::pteam(pool, {.max_par = 1}, [&](par::team& t) {
+        CHECK(std::this_thread::get_id() == caller_tid);
+        t.pfor(0, 10, [&](int i) { sum += i; });
+        t.pfor({.sched = par::schedule_dynamic}, 0, 10, [&](int i) { sum += i; });
+        t.barrier();
+    });
+    CHECK(ret == 1);
+    CHECK(sum == 90);
+}
+
+TEST_CASE("team concurrent") {
+    static constexpr uint32_t num_threads = 4;
+    par::thread_pool pool("test", num_threads);
+
+    auto run = [&]() {
+        for (int r = 0; r < 20; ++r) {
+            std::atomic_int count = 0;
+            par::pteam(pool, {}, [&](par::team& t) {
+                for (int step = 0; step < 5; ++step) {
+                    t.pfor(0, 100, [&](int) { ++count; });
+                }
+            });
+            CHECK(count == 500);
+        }
+    };
+
+    std::thread t1(run);
+    std::thread t2(run);
+    t1.join();
+    t2.join();
+}
+
+TEST_CASE("team nesting") {
+    static constexpr uint32_t num_threads = 4;
+    par::thread_pool pool("test", num_threads);
+
+    std::atomic_int32_t throws = 0;
+    std::atomic_int32_t local = 0;
+    par::prun(pool, {}, [&](uint32_t) {
+        try {
+            par::pteam(pool, {.max_par = 2}, [&](par::team& t) {
+                t.pfor(0, 2, [&](int) { ++local; });
+            });
+        }
+        catch (const std::runtime_error& err) {
+            CHECK(std::string_view(err.what()) == "unsupported nested par call");
+            ++throws;
+        }
+    });
+    CHECK(local == 2);
+    CHECK(throws == num_threads);
+}
@@ -3,8 +3,15 @@
 //
 #include <par/thread_pool.hpp>
 #include <par/prun.hpp>
+#include <par/cpu_limits.hpp>
 #include <doctest/doctest.h>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <thread>
 #include <vector>
 
@@ -241,3 +248,543 @@ TEST_CASE("global thread pool") {
     CHECK(ret >= 1);
     CHECK(count >= 1);
 }
+
+TEST_CASE("resize") {
+    par::thread_pool pool("test", 2, {.max_threads = 6, .auto_scale = false});
+    CHECK(pool.num_threads() == 2);
+    CHECK(pool.max_threads() == 6);
+    CHECK(pool.get_par() == 3);
+
+    auto run_static = [&]() {
+        std::vector<std::thread::id> thread_ids(pool.max_parallel_jobs());
+        auto ret = prun(pool, {.sched = par::schedule_static}, [&](uint32_t iid) {
+            thread_ids[iid] = std::this_thread::get_id();
+        });
+        CHECK(ret == pool.num_threads() + 1);
+        for (uint32_t i = 0; i < ret; ++i) {
+            CHECK(thread_ids[i] != std::thread::id());
+            for (uint32_t j = i + 1; j < ret; ++j) {
+                CHECK(thread_ids[i] != thread_ids[j]);
+            }
+        }
+    };
+
+    auto run_dynamic = [&]() {
+        std::atomic_uint32_t calls = 0;
+        auto ret = prun(pool, {}, [&](uint32_t) { ++calls; });
+        CHECK(ret == pool.num_threads() + 1);
+        CHECK(calls == ret);
+    };
+
+    run_static();
+    run_dynamic();
+
+    pool.resize(6);
+    CHECK(pool.num_threads() == 6);
+    CHECK(pool.get_par() == 7);
+    run_static();
+    run_dynamic();
+
+    pool.resize(1);
+    CHECK(pool.num_threads() == 1);
+    CHECK(pool.get_par() == 2);
+    run_static();
+    run_dynamic();
+
+    pool.resize(0);
+    CHECK(pool.get_par() == 1);
+    run_static();
+    run_dynamic();
+
+    pool.resize(4);
+    run_static();
+    run_dynamic();
+
+    CHECK_THROWS(pool.resize(7));
+    CHECK(pool.num_threads() == 4);
+}
+
+TEST_CASE("resize with running tasks") {
+    par::thread_pool pool("test", 4, {.max_threads = 4, .auto_scale = false});
+
+    std::atomic_uint32_t calls = 0;
+    auto task = [&](uint32_t) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ++calls;
+    };
+    std::thread t([&]() {
+        for (int i = 0; i < 20; ++i) {
+            // planned for 5 jobs, but the pool may shrink before the task is run
+            par::run_opts opts = {.sched = par::schedule_static, .max_par = 5};
+            const auto par = pool.adjust_par(5u, opts);
+            auto ret = pool.run_task(opts, par::thread_pool::task_func(task));
+            CHECK(ret == par);
+        }
+    });
+
+    for (uint32_t i = 0; i < 20; ++i) {
+        pool.resize(i % 5);
+    }
+    t.join();
+    CHECK(calls > 20);
+}
+
+TEST_CASE("resize from a worker") {
+    par::thread_pool pool("test", 2, {.max_threads = 4, .auto_scale = false});
+
+    std::atomic_uint32_t throws = 0;
+    prun(pool, {.sched = par::schedule_static}, [&](uint32_t i) {
+        if (i == 0) return;
+        try {
+            pool.resize(0);
+        }
+        catch (std::runtime_error&) {
+            ++throws;
+        }
+    });
+    CHECK(throws == 2);
+    CHECK(pool.num_threads() == 2);
+}
+
+TEST_CASE("global max_threads") {
+    // the global pool can grow when the cpu quota of the process rises
+    auto& global = par::thread_pool::global();
+    CHECK(global.max_threads() >= global.num_threads());
+    CHECK(global.max_threads() >= par::available_cpus());
+    global.resize(global.max_threads());
+    CHECK(global.num_threads() == global.max_threads());
+}
+
+TEST_CASE("default max_threads") {
+    par::thread_pool pool("test", 3, {.auto_scale = false});
+    CHECK(pool.num_threads() == 3);
+    CHECK(pool.max_threads() == 3);
+
+    par::thread_pool pool2("test", 1, {.min_threads = 2, .auto_scale = false});
+    CHECK(pool2.num_threads() == 2);
+    CHECK(pool2.max_threads() == 2);
+}
+
+TEST_CASE("max_par of elastic pools") {
+    par::thread_pool pool("test", 4, {.max_threads = 16, .auto_scale = false});
+    auto nop = [](uint32_t) {};
+
+    // clamped to the running workers, not to max_threads
+    CHECK(pool.run_task({.sched = par::schedule_static, .max_par = 100}, par::thread_pool::task_func(nop)) == 5);
+    CHECK(pool.run_task({.max_par = 100}, par::thread_pool::task_func(nop)) == 5);
+
+    // adjusted values are honored
+    par::run_opts opts = {.sched = par::schedule_static};
+    CHECK(pool.adjust_par(100u, opts) == 5);
+    CHECK(opts.max_par_adjusted);
+    pool.resize(2);
+    CHECK(pool.run_task(opts, par::thread_pool::task_func(nop)) == 5);
+
+    // the caller runs the jobs of the missing workers, no threads are started for them
+    const auto caller = std::this_thread::get_id();
+    std::vector<std::thread::id> ids(5);
+    auto record = [&](uint32_t i) { ids[i] = std::this_thread::get_id(); };
+    CHECK(pool.run_task(opts, par::thread_pool::task_func(record)) == 5);
+    CHECK(ids[0] == caller);
+    CHECK(ids[3] == caller);
+    CHECK(ids[4] == caller);
+    CHECK(pool.num_running_threads() == 2);
+}
+
+TEST_CASE("auto scale") {
+    par::thread_pool pool("test", 0, {
+        .min_threads = 1,
+        .max_threads = 4,
+        .idle_timeout = std::chrono::milliseconds(20)
+    });
+    CHECK(pool.num_threads() == 1);
+
+    // jobs which can't be taken by idle workers make the pool grow
+    std::atomic_bool started = false, release = false;
+    std::thread blocker([&]() {
+        prun(pool, {}, [&](uint32_t i) {
+            if (i == 0) return;
+            started = true;
+            while (!release) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    });
+    while (!started) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::atomic_uint32_t calls = 0;
+    prun(pool, {}, [&](uint32_t) {
+        ++calls;
+    });
+    CHECK(calls == 2); // planned before growing
+    CHECK(pool.num_threads() == 2);
+
+    release = true;
+    blocker.join();
+
+    calls = 0;
+    auto ret = prun(pool, {}, [&](uint32_t) { ++calls; });
+    CHECK(calls == ret);
+
+    // idle workers retire
+    for (int i = 0; i < 500 && pool.num_threads() > 1; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(pool.num_threads() == 1);
+
+    calls = 0;
+    ret = prun(pool, {.sched = par::schedule_static}, [&](uint32_t) { ++calls; });
+    CHECK(ret == 2);
+    CHECK(calls == 2);
+}
+
+TEST_CASE("lazy") {
+    par::thread_pool pool("test", 4, {.max_threads = 6, .auto_scale = false, .lazy = true});
+    CHECK(pool.num_threads() == 4);
+    CHECK(pool.num_running_threads() == 0);
+    CHECK(pool.get_par() == 5);
+
+    // workers are started as tasks need them
+    std::atomic_uint32_t calls = 0;
+    auto ret = prun(pool, {.max_par = 2}, [&](uint32_t) { ++calls; });
+    CHECK(ret == 2);
+    CHECK(calls == 2);
+    CHECK(pool.num_running_threads() == 1);
+
+    calls = 0;
+    std::atomic_uint32_t iids = 0;
+    ret = prun(pool, {.sched = par::schedule_static, .max_par = 4}, [&](uint32_t iid) {
+        ++calls;
+        iids |= 1 << iid;
+    });
+    CHECK(ret == 4);
+    CHECK(calls == 4);
+    CHECK(iids == 0b1111);
+    CHECK(pool.num_running_threads() == 3);
+
+    // growing a lazy pool only plans more workers
+    pool.resize(6);
+    CHECK(pool.num_threads() == 6);
+    CHECK(pool.num_running_threads() == 3);
+
+    calls = 0;
+    ret = prun(pool, {}, [&](uint32_t) { ++calls; });
+    CHECK(ret == 7);
+    CHECK(calls == 7);
+    CHECK(pool.num_running_threads() == 6);
+
+    pool.resize(2);
+    CHECK(pool.num_threads() == 2);
+    CHECK(pool.num_running_threads() == 2);
+
+    pool.resize(5);
+    CHECK(pool.num_running_threads() == 2);
+    pool.warm_up();
+    CHECK(pool.num_running_threads() == 5);
+    CHECK(pool.num_threads() == 5);
+
+    calls = 0;
+    ret = prun(pool, {.sched = par::schedule_static}, [&](uint32_t) { ++calls; });
+    CHECK(ret == 6);
+    CHECK(calls == 6);
+
+    // nothing to start in other pools
+    par::thread_pool eager("test", 2);
+    CHECK(eager.num_running_threads() == 2);
+    eager.warm_up(16 * 1024);
+    CHECK(eager.num_running_threads() == 2);
+}
+
+TEST_CASE("at_region_end") {
+    par::thread_pool pool("test", 2);
+    auto nop = []() {};
+    CHECK_FALSE(par::thread_pool::at_region_end(nop));
+
+    // called when the outermost region (or job on a worker) ends
+    std::vector<std::atomic_bool> fired(3);
+    bool fired_early = false;
+    const auto n = prun(pool, {.max_par = 3}, [&](uint32_t i) {
+        prun(pool, {.max_par = 1}, [&](uint32_t) {
+            CHECK(par::thread_pool::at_region_end([&fired, i]() { fired[i] = true; }));
+        });
+        if (fired[i]) fired_early = true;
+    });
+    CHECK(n == 3);
+    CHECK_FALSE(fired_early);
+    for (auto& f : fired) {
+        CHECK(f);
+    }
+}
+
+TEST_CASE("priority") {
+    par::run_opts opts;
+    CHECK(opts.priority == par::priority_normal);
+
+    par::thread_pool pool("test", 1);
+
+    // keep the only worker busy, so that the following tasks end up in the queue
+    std::atomic_bool started = false, release = false;
+    std::thread blocker([&]() {
+        prun(pool, {}, [&](uint32_t i) {
+            if (i == 0) {
+                // make sure the worker runs the other job
+                while (!started) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                return;
+            }
+            started = true;
+            while (!release) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    });
+    while (!started) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::mutex order_mutex;
+    std::vector<par::priority_class> worker_order;
+
+    auto run = [&](par::priority_class prio, std::atomic_bool& queued) {
+        prun(pool, {.priority = prio}, [&](uint32_t i) {
+            if (i == 0) {
+                // the worker job is already queued
+                // don't steal it before the worker has picked up something
+                queued = true;
+                while (true) {
+                    std::lock_guard lock(order_mutex);
+                    if (!worker_order.empty()) break;
+                }
+                return;
+            }
+            std::lock_guard lock(order_mutex);
+            worker_order.push_back(prio);
+        });
+    };
+
+    std::atomic_bool bg_queued = false, high_queued = false;
+    std::thread bg([&]() { run(par::priority_background, bg_queued); });
+    while (!bg_queued) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK_FALSE(pool.have_higher_priority_work(par::priority_background));
+
+    std::thread high([&]() { run(par::priority_high, high_queued); });
+    while (!high_queued) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(pool.have_higher_priority_work(par::priority_background));
+    CHECK_FALSE(pool.have_higher_priority_work(par::priority_high));
+
+    release = true;
+    blocker.join();
+    high.join();
+    bg.join();
+
+    REQUIRE(!worker_order.empty());
+    CHECK(worker_order.front() == par::priority_high);
+}
+
+TEST_CASE("wake up sleeping workers") {
+    // enough workers for several levels of the wake-up tree
+    static constexpr uint32_t num_threads = 40;
+    static constexpr uint32_t num_jobs = num_threads + 1;
+
+    // the default tree, a chain, and the caller waking up everyone
+    for (uint32_t fanout : {4u, 1u, 0u}) {
+        par::thread_pool pool("test", num_threads, {.auto_scale = false, .wake_up_fanout = fanout});
+
+        for (int r = 0; r < 3; ++r) {
+            // let the workers fall asleep
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+            // all jobs must run concurrently, so this hangs if a worker isn't woken up
+            std::latch all(num_jobs);
+            std::atomic_uint32_t iids_lo = 0, iids_hi = 0;
+            auto ret = prun(pool, {.sched = par::schedule_static}, [&](uint32_t iid) {
+                all.arrive_and_wait();
+                (iid < 32 ? iids_lo : iids_hi) |= 1u << (iid % 32);
+            });
+            CHECK(ret == num_jobs);
+            CHECK(iids_lo == ~0u);
+            CHECK(iids_hi == (1u << (num_jobs - 32)) - 1);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+            std::atomic_uint32_t calls = 0;
+            ret = prun(pool, {}, [&](uint32_t) {
+                ++calls;
+            });
+            CHECK(calls == ret);
+        }
+    }
+}
+
+TEST_CASE("concurrent callers") {
+    static constexpr uint32_t num_threads = 3;
+    static constexpr uint32_t num_callers = 16;
+    par::thread_pool pool("test", num_threads);
+
+    std::atomic_uint32_t num_bad = 0;
+    std::vector<std::thread> callers;
+    for (uint32_t c = 0; c < num_callers; ++c) {
+        callers.emplace_back([&, c]() {
+            for (uint32_t r = 0; r < 200; ++r) {
+                std::atomic_uint32_t calls = 0;
+                std::atomic_uint32_t iids = 0;
+                const auto ret = prun(pool, {.max_par = 2 + (c + r) % num_threads}, [&](uint32_t iid) {
+                    ++calls;
+                    iids |= (1 << iid);
+                });
+                if (calls != ret || iids != (1u << ret) - 1) {
+                    ++num_bad;
+                }
+            }
+        });
+    }
+    for (auto& c : callers) {
+        c.join();
+    }
+    CHECK(num_bad == 0);
+}
+
+TEST_CASE("run_task_async") {
+    static constexpr uint32_t num_threads = 3;
+    par::thread_pool pool("test", num_threads);
+    const auto caller = std::this_thread::get_id();
+
+    for (uint32_t max_par : {0, 1, 2, 3, 100}) {
+        std::atomic_uint32_t calls = 0;
+        std::atomic_uint32_t iids = 0;
+        std::atomic_uint32_t on_caller = 0;
+        std::atomic_uint32_t calls_at_completion = 0;
+        std::latch done(1);
+        const auto ret = pool.run_task_async({.max_par = max_par}, [&](uint32_t iid) {
+            ++calls;
+            iids |= (1 << iid);
+            if (std::this_thread::get_id() == caller) ++on_caller;
+        }, [&]() {
+            calls_at_completion = calls.load();
+            if (std::this_thread::get_id() == caller) ++on_caller;
+            done.count_down();
+        });
+        done.wait();
+        const uint32_t expected = max_par ? std::min(max_par, num_threads) : num_threads;
+        CHECK(ret == expected);
+        CHECK(calls == expected);
+        CHECK(calls_at_completion == expected);
+        CHECK(iids == (1u << expected) - 1);
+        CHECK(on_caller == 0);
+    }
+
+    // the caller is not blocked by the jobs
+    std::latch release(1);
+    std::latch done(1);
+    pool.run_task_async({}, [&](uint32_t) {
+        release.wait();
+    }, [&]() {
+        done.count_down();
+    });
+    CHECK_FALSE(done.try_wait());
+    release.count_down();
+    done.wait();
+
+    // the task is destroyed before on_complete
+    auto counter = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = counter;
+    std::atomic_bool expired = false;
+    std::latch destroyed(1);
+    pool.run_task_async({}, [c = std::move(counter)](uint32_t) {}, [&]() {
+        expired = weak.expired();
+        destroyed.count_down();
+    });
+    destroyed.wait();
+    CHECK(expired);
+
+    // and on_complete right after it runs
+    std::latch released(1);
+    std::shared_ptr<void> guard(nullptr, [&](void*) { released.count_down(); });
+    pool.run_task_async({}, [](uint32_t) {}, [g = std::move(guard)]() {});
+    for (int w = 0; w < 5000 && !released.try_wait(); ++w) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(released.try_wait());
+}
+
+TEST_CASE("run_task_async chains") {
+    std::atomic_uint32_t calls = 0;
+    {
+        par::thread_pool pool("test", 3);
+
+        // on_complete runs the next task, the destructor waits for all of them
+        struct chain {
+            par::thread_pool& pool;
+            std::atomic_uint32_t& calls;
+            uint32_t left;
+            void operator()() {
+                if (!left) return;
+                pool.run_task_async({.max_par = 2}, [c = &calls](uint32_t) { ++*c; }, chain{pool, calls, left - 1});
+            }
+        };
+        chain{pool, calls, 50}();
+    }
+    CHECK(calls == 100);
+
+    // without workers everything runs on the caller
+    par::thread_pool none("none", 0);
+    const auto caller = std::this_thread::get_id();
+    bool completed = false;
+    CHECK(none.run_task_async({}, [&](uint32_t iid) {
+        CHECK(iid == 0);
+        CHECK(std::this_thread::get_id() == caller);
+    }, [&]() { completed = true; }) == 1);
+    CHECK(completed);
+}
+
+TEST_CASE("run_task_async on lazy pools") {
+    par::thread_pool pool("test", 3, {.auto_scale = false, .lazy = true});
+
+    // the first worker is busy, so a static region can't be picked up and holds the broadcast region
+    std::latch started(1);
+    std::latch hold(1);
+    std::latch held(1);
+    pool.run_task_async({.max_par = 1}, [&](uint32_t) {
+        started.count_down();
+        hold.wait();
+    }, [&]() {
+        held.count_down();
+    });
+    started.wait();
+    CHECK(pool.num_running_threads() == 1);
+
+    std::thread static_caller([&]() {
+        par::prun(pool, {.sched = par::schedule_static, .max_par = 2}, [](uint32_t) {});
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // waits for the broadcast region while starting the other workers
+    std::thread dynamic_caller([&]() {
+        par::prun(pool, {.max_par = 3}, [](uint32_t) {});
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // doesn't wait for them, so this would hang
+    std::atomic_uint32_t calls = 0;
+    std::latch done(1);
+    CHECK(pool.run_task_async({.max_par = 3}, [&](uint32_t) {
+        ++calls;
+    }, [&]() {
+        done.count_down();
+    }) == 3);
+
+    hold.count_down();
+    static_caller.join();
+    dynamic_caller.join();
+    held.wait();
+    done.wait();
+    CHECK(calls == 3);
+    CHECK(pool.num_running_threads() == 3);
+}